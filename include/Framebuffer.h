@@ -30,6 +30,44 @@ public:
      */
     static void draw_image_to_framebuffer(uint8_t *fb_ptr, const fb_var_screeninfo &vinfo,
                                           const ImageData &img, const int offset_x, const int offset_y);
+
+    /**
+     * 将 A8 覆盖率掩码着色后直接混合到 Framebuffer（单次遍历，32位格式使用 NEON）
+     * @param fb_ptr      Framebuffer 内存指针
+     * @param vinfo       Framebuffer 屏幕信息
+     * @param mask        8位覆盖率数据
+     * @param mask_width  掩码宽度
+     * @param mask_height 掩码高度
+     * @param mask_stride 掩码每行字节数
+     * @param offset_x    目标 X 坐标（可为负数，自动裁剪）
+     * @param offset_y    目标 Y 坐标（可为负数，自动裁剪）
+     * @param color       32位 ARGB 颜色，alpha 作为整体不透明度
+     */
+    static void draw_mask_to_framebuffer(uint8_t *fb_ptr, const fb_var_screeninfo &vinfo,
+                                         const uint8_t *mask, int mask_width, int mask_height, int mask_stride,
+                                         int offset_x, int offset_y, uint32_t color);
+
+    /**
+     * 纯色填充矩形区域
+     * @param fb_ptr      Framebuffer 内存指针
+     * @param vinfo       Framebuffer 屏幕信息
+     * @param color       32位 ARGB 颜色
+     */
+    static void fill_rect(uint8_t *fb_ptr, const fb_var_screeninfo &vinfo,
+                          int x, int y, int width, int height, uint32_t color);
+
+    /**
+     * 保存矩形区域的原始像素（超出屏幕部分自动裁剪）
+     * @param out         输出缓冲区，按 Framebuffer 原生格式逐行存放
+     */
+    static void save_region(const uint8_t *fb_ptr, const fb_var_screeninfo &vinfo,
+                            int x, int y, int width, int height, std::vector<uint8_t> &out);
+
+    /**
+     * 恢复 save_region 保存的像素，参数需与保存时一致
+     */
+    static void restore_region(uint8_t *fb_ptr, const fb_var_screeninfo &vinfo,
+                               int x, int y, int width, int height, const std::vector<uint8_t> &data);
 };
 
 #endif // FRAME_BUFFER_H
\ No newline at end of file
@@ -3,7 +3,9 @@
 
 #include <string>
 #include <vector>
+#include <memory>
 #include <stdexcept>
+#include <linux/fb.h>
 #include <ImageDecoder.h>
 
 class QrCodeGenerator
@@ -17,6 +19,41 @@ public:
         High = 3      // QR_ECLEVEL_H
     };
 
+    // 1-bit 模块矩阵（含边距）
+    struct Matrix
+    {
+        int width = 0;             // 每行模块数
+        int row_bytes = 0;         // 每行字节数
+        std::vector<uint8_t> bits; // 按行打包，高位在前，1 为前景
+
+        bool module(int x, int y) const
+        {
+            return bits[y * row_bytes + (x >> 3)] & (0x80 >> (x & 7));
+        }
+    };
+
+    /**
+     * 编码二维码，结果按 (文本, 纠错等级, 边距) 缓存
+     * @param text 要编码的文本
+     * @param margin 二维码边距（模块数）
+     * @param level 纠错等级
+     */
+    static std::shared_ptr<const Matrix> encode(
+        const std::string &text,
+        int margin = 4,
+        ErrorCorrection level = ErrorCorrection::Medium);
+
+    /**
+     * 将模块矩阵按整数倍放大后直接绘制到 Framebuffer
+     * @param size 每个模块的像素数（放大倍数）
+     * @param fg_color 前景色（RGBA）
+     * @param bg_color 背景色（RGBA），alpha 为 0 时不绘制背景
+     */
+    static void draw(uint8_t *fb_ptr, const fb_var_screeninfo &vinfo, const Matrix &qr,
+                     int x, int y, int size = 5,
+                     uint32_t fg_color = 0x000000FF,
+                     uint32_t bg_color = 0xFFFFFFFF);
+
     /**
      * 生成二维码图像数据
      * @param text 要编码的文本
@@ -34,4 +71,4 @@ public:
         uint32_t bg_color = 0xFFFFFFFF, // RGBA: 白色
         ErrorCorrection level = ErrorCorrection::Medium);
 };
-#endif // QRCODE_GENERAATOR_H
\ No newline at end of file
+#endif // QRCODE_GENERAATOR_H
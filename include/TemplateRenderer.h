@@ -0,0 +1,93 @@
+#ifndef TEMPLATE_RENDERER_H
+#define TEMPLATE_RENDERER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+#include <linux/fb.h>
+#include "TextRenderer.h"
+
+/**
+ * 价签模板：由服务器下发的布局描述(JSON)，包含文本/数字/图片槽位
+ *
+ * {
+ *   "width": 800, "height": 400, "background": "FFFFFFFF",
+ *   "slots": [
+ *     {"name": "title", "type": "text", "left": 20, "top": 10, "width": 760, "height": 60,
+ *      "size": 40, "color": "000000FF", "align": "center", "wrap": true, "fit": true, "value": ""},
+ *     {"name": "price", "type": "number", "decimals": 2, "prefix": "¥", ...},
+ *     {"name": "logo", "type": "image", "value": "<文件名>"}
+ *   ]
+ * }
+ */
+struct TemplateSlot
+{
+    enum class Type
+    {
+        Text,
+        Number,
+        Image
+    };
+
+    std::string name;
+    Type type = Type::Text;
+    int left = 0;
+    int top = 0;
+    int width = 0;
+    int height = 0;
+
+    TextRenderConfig font;
+    TextBox box;
+
+    // 数字槽位格式
+    int decimals = 2;
+    std::string decimal_point = ".";
+    std::string prefix;
+    std::string suffix;
+
+    std::string value;
+    const SpriteSet *sprites = nullptr; // 数字快速绘制路径，模板加载时预先构建
+    std::vector<uint8_t> backing; // 槽位下方的原始像素，用于局部重绘
+};
+
+class TemplateRenderer
+{
+public:
+    explicit TemplateRenderer(TextRenderer &text_renderer);
+
+    // 加载模板文件，失败抛出异常
+    void load(const std::string &path);
+
+    // 完整绘制模板，(x, y) 为模板左上角
+    void render(uint8_t *fb_ptr, const fb_var_screeninfo &vinfo, int x, int y);
+
+    /**
+     * 更新字段值，只重绘发生变化的槽位
+     * @return 重绘的槽位数量
+     */
+    int update(uint8_t *fb_ptr, const fb_var_screeninfo &vinfo,
+               const std::map<std::string, std::string> &fields);
+
+    // 设置字段值但不绘制（用于首次绘制前）
+    void set_values(const std::map<std::string, std::string> &fields);
+
+    const std::string &path() const;
+
+private:
+    void draw_slot(uint8_t *fb_ptr, const fb_var_screeninfo &vinfo, TemplateSlot &slot);
+    std::string format_number(const TemplateSlot &slot) const;
+
+    TextRenderer &m_text;
+    std::string m_path;
+    int m_width = 0;
+    int m_height = 0;
+    uint32_t m_background = 0; // RGBA
+    std::vector<TemplateSlot> m_slots;
+
+    int m_x = 0;
+    int m_y = 0;
+    bool m_rendered = false;
+};
+
+#endif // TEMPLATE_RENDERER_H
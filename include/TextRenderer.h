@@ -2,15 +2,91 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <unordered_map>
+#include <linux/fb.h>
 #include <ImageDecoder.h>
 #include "stb_truetype.h"
 
 struct TextRenderConfig
 {
     std::string font_path = "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf";
-    uint32_t color = 0x000000FF;    // 字体颜色 (RGBA)
-    uint32_t bg_color = 0x00000000; // 背景颜色 (RGBA) 0xFFFFFFFF 白色背景  透明 0x00000000
-    int size = 24;                  // 字体大小(像素)
+    std::vector<std::string> fallback_fonts{}; // 备用字体，主字体缺字时依次查找
+    uint32_t color = 0x000000FF;               // 字体颜色 (RGBA)
+    uint32_t bg_color = 0x00000000;            // 背景颜色 (RGBA) 0xFFFFFFFF 白色背景  透明 0x00000000
+    int size = 24;                             // 字体大小(像素)
+    bool sdf = false;                          // SDF 字形模式：字形只按参考字号光栅化一次，任意字号缩放绘制
+};
+
+enum class TextAlign
+{
+    Left = 0,
+    Center = 1,
+    Right = 2
+};
+
+// 文本排版区域
+struct TextBox
+{
+    int width = 0;                     // 区域宽度，0 表示不限制
+    int height = 0;                    // 区域高度，0 表示不限制
+    bool wrap = false;                 // 超出宽度时自动换行
+    bool auto_fit = false;             // 自动缩小字号以适应区域
+    int min_size = 8;                  // 自动缩放的最小字号
+    int line_spacing = 0;              // 额外行间距(像素)
+    TextAlign align = TextAlign::Left; // 水平对齐
+};
+
+// 单个字形的 A8 覆盖率掩码
+struct GlyphMask
+{
+    std::vector<uint8_t> coverage; // 覆盖率数据 (width * height)
+    int width = 0;
+    int height = 0;
+    int x_off = 0;   // 相对笔位置的水平偏移
+    int y_off = 0;   // 相对基线的垂直偏移（通常为负数）
+    int advance = 0; // 水平步进(像素)
+};
+
+// 排版结果
+struct TextLayout
+{
+    struct Glyph
+    {
+        int face;  // 字体序号
+        int index; // 字形索引
+        int x;     // 笔位置，相对排版原点
+        int y;     // 基线位置，相对排版原点
+    };
+
+    std::vector<Glyph> glyphs;
+    int size = 0;        // 实际使用的字号
+    int width = 0;       // 最宽一行的宽度
+    int height = 0;      // 总高度
+    int line_height = 0; // 行高(不含额外间距)
+    int line_count = 0;
+};
+
+// 预渲染的数字/货币符号精灵条，按 (字体, 字号, 颜色) 构建
+struct SpriteSet
+{
+    struct Sprite
+    {
+        int x = 0;       // 在精灵条中的列偏移
+        int width = 0;
+        int height = 0;
+        int x_off = 0;   // 相对笔位置的水平偏移
+        int y_off = 0;   // 相对基线的垂直偏移
+        int advance = 0; // 预计算的水平步进
+    };
+
+    std::vector<uint8_t> strip; // A8 精灵条，所有字形横向排列
+    int strip_width = 0;
+    int strip_height = 0;
+    int baseline = 0; // 精灵条内基线位置
+    int ascent = 0;
+    int line_height = 0;
+    uint32_t color = 0; // RGBA
+    std::unordered_map<uint32_t, Sprite> sprites;
 };
 
 class TextRenderer
@@ -19,15 +95,111 @@ public:
     TextRenderer();
     ~TextRenderer();
 
+    // 切换字体配置，字体文件与各字号度量只加载一次
     void init(const TextRenderConfig &config);
-    ImageData render_text(const std::string &text);
+
+    /**
+     * 排版 UTF-8 文本：字距调整、换行与自动字号
+     * 结果按 (文本, 字体, 区域) 缓存，重复标签只需一次查找
+     */
+    const TextLayout &layout(const std::string &text, const TextBox &box = {});
+
+    /**
+     * 直接将文本绘制到 Framebuffer，不生成中间图像
+     * @param x  文本框左上角 X
+     * @param y  文本框左上角 Y（首行基线位于 y + ascent）
+     */
+    void draw_text(uint8_t *fb_ptr, const fb_var_screeninfo &vinfo,
+                   const std::string &text, int x, int y);
+
+    // 在指定区域内排版并绘制文本
+    void draw_text_box(uint8_t *fb_ptr, const fb_var_screeninfo &vinfo,
+                       const std::string &text, int x, int y, const TextBox &box);
+
+    // 绘制已排版的文本
+    void draw_layout(uint8_t *fb_ptr, const fb_var_screeninfo &vinfo,
+                     const TextLayout &layout, int x, int y);
+
+    /**
+     * 获取当前字体配置下的数字精灵条，不存在时预先构建
+     * @param charset  除 0-9 . , - 外需要包含的字符（如货币符号）
+     */
+    const SpriteSet &sprite_set(const std::string &charset = "");
+
+    /**
+     * 使用精灵条绘制格式化后的数字，不做逐字排版
+     * @return 文本中有精灵条不包含的字符时返回 false（未绘制）
+     */
+    bool draw_sprites(uint8_t *fb_ptr, const fb_var_screeninfo &vinfo, const SpriteSet &set,
+                      const std::string &text, int x, int y, const TextBox &box = {});
+
+    // 文本宽度(像素)
+    int measure_text(const std::string &text);
+    // 行高 = ascent - descent + lineGap
+    int line_height() const;
+    int ascent() const;
 
 private:
+    struct FontFace
+    {
+        std::string path;
+        std::vector<unsigned char> buffer;
+        stbtt_fontinfo info;
+        int ascent;
+        int descent;
+        int line_gap;
+        std::unordered_map<uint32_t, int> glyph_index; // 码点 -> 字形索引
+        std::unordered_map<int, int> advance;          // 字形索引 -> 未缩放步进
+    };
+
+    // 参考字号下的有符号距离场
+    struct SdfGlyph
+    {
+        std::vector<uint8_t> field;
+        int width = 0;
+        int height = 0;
+        int x_off = 0;
+        int y_off = 0;
+    };
+
+    struct FontMetrics
+    {
+        float scale;
+        int ascent;
+        int descent;
+        int line_gap;
+    };
+
+    // 解码后的字符
+    struct ShapedChar
+    {
+        uint32_t codepoint;
+        int face;
+        int index;
+    };
+
+    int load_face(const std::string &path);
+    int find_glyph_index(int face, uint32_t codepoint);
+    int glyph_advance(int face, int index);
+    FontMetrics metrics_for_size(int size) const;
+    void shape(const std::string &text, std::vector<ShapedChar> &chars);
+    bool layout_at_size(const std::vector<ShapedChar> &chars, int size, const TextBox &box, TextLayout &out);
+    const GlyphMask &get_glyph(int face, int index, int size);
+    const SdfGlyph &get_sdf_glyph(int face, int index);
+    const GlyphMask &render_sdf_glyph(int face, int index, int size);
+
     TextRenderConfig m_config;
-    std::vector<unsigned char> m_ttf_buffer;
-    stbtt_fontinfo m_font;
-    float m_scale;
-    int m_ascent;
-    int m_descent;
-    int m_lineGap;
-};
\ No newline at end of file
+    std::vector<std::unique_ptr<FontFace>> m_faces; // 已加载的字体
+    std::vector<int> m_chain;                       // 当前字体链（主字体 + 备用字体）
+    std::string m_chain_key;
+    FontMetrics m_metrics;
+
+    std::unordered_map<uint64_t, GlyphMask> m_glyph_cache;     // (字体, 字号, 字形) -> 掩码
+    std::unordered_map<uint64_t, SdfGlyph> m_sdf_cache;        // (字体, 字形) -> 距离场
+    GlyphMask m_sdf_scratch;                                   // SDF 缩放输出，复用避免分配
+    std::vector<float> m_sdf_row;
+    std::vector<int> m_sdf_cols;
+    std::vector<float> m_sdf_fracs;
+    std::unordered_map<std::string, TextLayout> m_layout_cache; // 排版结果
+    std::unordered_map<std::string, SpriteSet> m_sprite_cache;  // 数字精灵条
+};
@@ -0,0 +1,105 @@
+#ifndef ASSET_STORE_H
+#define ASSET_STORE_H
+
+#include <string>
+#include <map>
+#include <set>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+#include <json/json.h>
+
+/**
+ * 下载目录的资源索引，文件以 MD5+扩展名命名
+ * 记录每个文件的大小、最后使用时间及各设备播放列表的引用；
+ * 后台线程在超出磁盘配额时逐个删除最久未使用且未被引用的文件，
+ * 当前或待下载播放列表需要的文件、下载中的文件永远不会被删除。
+ * 同时记录文件校验通过时的大小、修改时间和 inode，未变化的文件无需重新计算 MD5；
+ * 另有低 I/O 优先级的后台线程定期重新校验，发现真实的损坏；
+ * 启动时对没有校验记录的文件、发现损坏后对全部文件做一次多线程批量校验；
+ * 校验通过的文件在后台线程交给 VerifiedHook，用于生成分块清单等需要读取整个文件的索引
+ */
+class AssetStore
+{
+public:
+    using VerifiedHook = std::function<void(const std::string &name, const std::atomic<bool> &cancelled)>;
+
+    explicit AssetStore(const std::string &dir);
+    ~AssetStore();
+
+    AssetStore(const AssetStore &) = delete;
+    AssetStore &operator=(const AssetStore &) = delete;
+
+    // 文件下载完成或被使用
+    void touch(const std::string &name);
+    // 设备当前播放列表引用的文件，替换该设备之前的引用
+    void set_references(const std::string &device_id, const std::set<std::string> &names);
+    // 下载中的文件，pin 与 unpin 成对调用
+    void pin(const std::string &name);
+    void unpin(const std::string &name);
+
+    // 文件自上次校验后未被修改且 MD5 一致
+    bool is_verified(const std::string &name, const std::string &md5);
+    // 记录文件当前状态已校验通过
+    void mark_verified(const std::string &name, const std::string &md5);
+    // 有校验记录的文件
+    std::vector<std::string> verified_names();
+    // 设置后对已校验的文件各调用一次，之后每次校验通过时调用；在后台校验线程执行
+    void set_verified_hook(VerifiedHook hook);
+
+    // 资源占用上限（字节），0 表示按所在分区容量的 70%
+    void set_quota(uint64_t bytes);
+    uint64_t usage();
+
+private:
+    struct Asset
+    {
+        uint64_t size = 0;
+        int64_t last_used = 0; // 秒
+        // 校验信息，md5 为空表示未校验
+        std::string md5;
+        int64_t mtime_ns = 0;
+        uint64_t inode = 0;
+        int64_t verified_at = 0; // 秒
+    };
+
+    void scan();
+    void load();
+    void save_locked();
+    bool is_asset(const std::string &name) const;
+    bool is_protected_locked(const std::string &name) const;
+    bool evict_one();
+    void gc_loop();
+    void scrub_loop();
+    bool scrub_one();
+    // force 为 false 时跳过已校验且未变化的文件
+    void verify_all(bool force);
+    void clear_verified(const std::string &name);
+    void run_verified_hook();
+
+    std::string dir_;
+    std::string index_path_;
+    std::map<std::string, Asset> assets_;
+    std::map<std::string, std::set<std::string>> references_; // 设备 -> 引用的文件
+    std::map<std::string, int> pinned_;
+    uint64_t total_;
+    uint64_t quota_;
+    bool dirty_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_;
+    bool gc_requested_;
+    bool verify_requested_;
+    std::atomic<bool> cancel_verify_;
+    VerifiedHook verified_hook_;
+    std::set<std::string> hook_pending_; // 校验通过、等待交给 hook 的文件
+    std::thread gc_thread_;
+    std::thread scrub_thread_;
+};
+
+#endif // ASSET_STORE_H
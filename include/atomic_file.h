@@ -0,0 +1,24 @@
+#ifndef ATOMIC_FILE_H
+#define ATOMIC_FILE_H
+
+#include <string>
+
+/**
+ * 断电安全的文件写入
+ * 内容先写入同目录下的临时文件并落盘，再用 rename 替换目标文件并同步目录，
+ * 目标路径上只会是旧的完整内容或新的完整内容
+ */
+class AtomicFile
+{
+public:
+    // 写入 path.tmp 后发布到 path，失败时 errno 保留原因
+    static bool write(const std::string &path, const std::string &content);
+    // 把已写完的临时文件落盘并发布到 path
+    static bool publish(const std::string &tmp_path, const std::string &path);
+
+private:
+    // 替换目标文件并同步所在目录，使 rename 本身也落盘
+    static bool rename_synced(const std::string &tmp_path, const std::string &path);
+};
+
+#endif // ATOMIC_FILE_H
@@ -0,0 +1,53 @@
+#ifndef BULK_VERIFIER_H
+#define BULK_VERIFIER_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+
+/**
+ * 批量文件校验
+ * 多个线程同时计算不同文件的 MD5，每个文件按大块映射并预读，
+ * 全量校验的速度受存储带宽限制而不是单核计算
+ */
+class BulkVerifier
+{
+public:
+    struct Item
+    {
+        std::string path;
+        std::string expected_md5;
+        uint64_t size = 0;
+    };
+
+    struct Progress
+    {
+        size_t files_done = 0;
+        size_t files_total = 0;
+        uint64_t bytes_done = 0;
+        uint64_t bytes_total = 0;
+        double bytes_per_sec = 0;
+    };
+
+    // 每个文件计算完成后调用，md5 为空表示读取失败（可能在多个线程中同时调用）
+    using ResultHandler = std::function<void(const Item &item, const std::string &md5)>;
+    // 约每秒调用一次，结束时再调用一次
+    using ProgressHandler = std::function<void(const Progress &progress)>;
+
+    // threads 为 0 时按 CPU 核数
+    explicit BulkVerifier(int threads = 0);
+
+    void set_cancel_flag(const std::atomic<bool> *cancelled) { cancelled_ = cancelled; }
+
+    // 校验全部文件，返回时所有结果均已回调
+    Progress run(std::vector<Item> items, const ResultHandler &on_result,
+                 const ProgressHandler &on_progress = nullptr);
+
+private:
+    int threads_;
+    const std::atomic<bool> *cancelled_;
+};
+
+#endif // BULK_VERIFIER_H
@@ -0,0 +1,37 @@
+#ifndef CHUNK_MANIFEST_H
+#define CHUNK_MANIFEST_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <json/json.h>
+
+/**
+ * 文件的内容分块清单
+ * 按内容确定分块边界（gear 滚动哈希，最小 16KB、平均 64KB、最大 256KB），
+ * 文件中间插入或删除数据只影响附近的块，重新导出的视频大部分块与旧版本相同；
+ * 服务器在资源旁提供 <地址>.chunks，须使用相同的算法和参数生成：
+ * {"algorithm":"gear","min":16384,"avg":65536,"max":262144,"size":N,"chunks":[["<块MD5>",长度],...]}
+ */
+class ChunkManifest
+{
+public:
+    struct Chunk
+    {
+        uint64_t offset = 0;
+        uint32_t length = 0;
+        std::string md5;
+    };
+
+    uint64_t size = 0;
+    std::vector<Chunk> chunks;
+
+    /// @brief 对本地文件分块并计算每块的 MD5
+    static bool build(const std::string &path, ChunkManifest &manifest, const std::atomic<bool> *cancelled = nullptr);
+    /// @brief 解析清单，算法参数与本地不同或块长度之和不等于文件大小时失败
+    bool parse(const Json::Value &root);
+    Json::Value to_json() const;
+};
+
+#endif // CHUNK_MANIFEST_H
@@ -0,0 +1,49 @@
+#ifndef CHUNK_STORE_H
+#define CHUNK_STORE_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+#include "chunk_manifest.h"
+
+/**
+ * 本地块存储
+ * 不另外保存块数据，直接以下载目录中已校验的资源文件为块来源；
+ * 各文件的分块清单缓存在 chunks/ 目录，由后台校验线程生成，文件大小或修改时间变化后重新分块。
+ * 下载时只使用已缓存的清单，不在下载路径上读取整个文件
+ */
+class ChunkStore
+{
+public:
+    // 文件是否可作为块来源（已校验且未被修改）
+    using SourceCheck = std::function<bool(const std::string &name)>;
+    using Ranges = std::vector<std::pair<uint64_t, uint64_t>>;
+
+    ChunkStore(const std::string &dir, SourceCheck usable);
+
+    /// @brief 用本地文件中相同的块填充目标文件
+    /// @param manifest 目标文件的清单
+    /// @param fd 已预分配的目标文件
+    /// @param extension 只在同类型的文件中查找，如 ".mp4"
+    /// @param exclude 目标文件本身的名字
+    /// @return 已写入的区间 [start, end)，按起点排序并合并
+    Ranges seed(const ChunkManifest &manifest, int fd, const std::string &extension,
+                const std::string &exclude, const std::atomic<bool> &cancelled);
+
+    /// @brief 缓存的清单不存在或已失效时重新分块并保存，耗时与文件大小成正比
+    /// @param name 下载目录中的文件名
+    void refresh(const std::string &name, const std::atomic<bool> &cancelled);
+
+private:
+    // 读取缓存的清单，与文件当前的大小和修改时间一致时返回 true
+    bool cached(const std::string &name, ChunkManifest &manifest);
+    void prune();
+
+    std::string dir_;
+    std::string index_dir_;
+    SourceCheck usable_;
+};
+
+#endif // CHUNK_STORE_H
@@ -0,0 +1,24 @@
+#ifndef CONTENT_CODEC_H
+#define CONTENT_CODEC_H
+
+#include <string>
+#include <cstddef>
+
+/**
+ * 压缩数据解码（gzip / deflate / br）
+ * HTTP 响应由 httplib 边接收边解压，这里用于 MQTT 等自带压缩标记的消息；
+ * 分块解压并限制解压后的大小，异常数据不会占满内存
+ */
+class ContentCodec
+{
+public:
+    static constexpr size_t kMaxDecodedSize = 16 * 1024 * 1024;
+
+    /// @brief 解压整段数据
+    /// @param encoding gzip、deflate 或 br
+    /// @return 格式不支持、数据损坏或超过 max_size 时返回 false
+    static bool decompress(const std::string &encoding, const std::string &data, std::string &out,
+                           size_t max_size = kMaxDecodedSize);
+};
+
+#endif // CONTENT_CODEC_H
@@ -9,6 +9,8 @@
 #include <mutex>
 #include <linux/fb.h>
 #include "TextRenderer.h"
+#include "TemplateRenderer.h"
+#include <map>
 
 class Display
 {
@@ -33,7 +35,15 @@ private:
 
     std::unique_ptr<TextRenderer> m_text_renderer;
 
+    // 本地渲染的价签模板，模板文字用单独的渲染器，与 m_text_renderer 分属不同线程
+    std::unique_ptr<TextRenderer> template_text_;
+    std::unique_ptr<TemplateRenderer> template_;
+    MediaItem template_media_;
+    std::map<std::string, std::string> template_fields_;
+    std::mutex template_mutex_;
+
     void updatePrice(const MediaItem &media, const std::string &local_path);
+    void updateTemplate(const MediaItem &media, const std::string &local_path);
     void updateBackground(const MediaItem &media, const std::string &local_path);
     void display_image(const std::string &image_path, const int offset_x, const int offset_y);
     void display_image_data(const ImageData &image_data, const int offset_x, const int offset_y);
@@ -62,6 +72,8 @@ public:
 
     std::string getDeviceId() const;
     void addMediaItem(const MediaItem &media, const std::string &local_path);
+    // 更新模板字段，只重绘变化的槽位
+    void updateTemplateFields(const std::map<std::string, std::string> &fields);
     void clear();
     // 显示配置
     void show_config();
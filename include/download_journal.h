@@ -0,0 +1,54 @@
+#ifndef DOWNLOAD_JOURNAL_H
+#define DOWNLOAD_JOURNAL_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include <json/json.h>
+#include "task_repository.h"
+
+/**
+ * 下载日志，断电重启后恢复下载
+ * pending.json 保存尚未完成的任务队列；
+ * 每个下载中的文件旁保存 <文件>.journal，记录地址、大小、校验信息和已完成的区间
+ */
+class DownloadJournal
+{
+public:
+    struct Progress
+    {
+        std::string url;
+        uint64_t size = 0;
+        std::string etag;
+        std::string last_modified;
+        std::vector<std::pair<uint64_t, uint64_t>> ranges; // 已写入磁盘的区间 [start, end)
+    };
+
+    explicit DownloadJournal(const std::string &dir);
+
+    // 任务队列，修改只在内存中进行，由 flush_tasks 写入磁盘
+    void add_task(const MediaItem &task);
+    void remove_task(const MediaItem &task);
+    // 有修改时保存任务队列；需要同步写盘，调用方应先释放自己持有的锁
+    void flush_tasks();
+    std::vector<MediaItem> pending_tasks();
+    static std::string task_key(const MediaItem &task);
+
+    // 文件下载进度
+    bool has_progress(const std::string &local_path);
+    bool load_progress(const std::string &local_path, Progress &progress);
+    bool save_progress(const std::string &local_path, const Progress &progress);
+    void remove_progress(const std::string &local_path);
+
+private:
+    static bool read_json(const std::string &path, Json::Value &root);
+
+    std::string tasks_path_;
+    Json::Value tasks_;
+    bool tasks_dirty_;
+    std::mutex mutex_;
+    std::mutex save_mutex_; // 按修改的先后顺序写盘，较旧的内容不会覆盖较新的
+};
+
+#endif // DOWNLOAD_JOURNAL_H
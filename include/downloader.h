@@ -3,15 +3,29 @@
 
 #include <string>
 #include <functional>
-#include <queue>
+#include <deque>
+#include <array>
+#include <atomic>
 #include <mutex>
 #include <condition_variable>
 #include <thread>
+#include <chrono>
 #include <filesystem>
 #include "task_repository.h"
 #include <memory>
 #include <vector>
 #include <httplib.h>
+#include <map>
+#include "download_journal.h"
+#include "resource_probe.h"
+#include "range_downloader.h"
+#include "asset_store.h"
+#include "rate_limiter.h"
+#include "retry_policy.h"
+#include "peer_cache.h"
+#include "multicast_push.h"
+#include "chunk_store.h"
+#include "origin_selector.h"
 
 class Downloader
 {
@@ -32,34 +46,152 @@ public:
     //     DownloadCallback callback;
     // };
 
-    Downloader(const std::string &url_root);
+    // 优先级，数值越小越先下载
+    enum class Priority
+    {
+        Visible = 0,  // 当前屏幕需要的图片/模板
+        Video = 1,    // 当前屏幕的视频
+        Prefetch = 2, // 非当前显示设备的预取
+    };
+
+    /// @param max_concurrent 同时进行的下载数
+    Downloader(const std::string &url_root, size_t max_concurrent = 3);
     ~Downloader();
 
+    /// @brief 设置下载回调，并恢复上次未完成的任务
     void setDownloadCallback(DownloadCallback callback);
+    /// @brief 按类型决定优先级：视频为 Video，其余为 Visible
     void add_task(const MediaItem &media);
+    void add_task(const MediaItem &media, Priority priority);
+    /// @brief 设备的新播放列表，开启新的批次（epoch）
+    /// 旧批次中不再需要的下载从队列移除，正在下载的直接中止
+    /// @param prefetch 非当前显示设备，全部按 Prefetch 排队
+    void schedule(const std::string &device_id, const std::vector<MediaItem> &items, bool prefetch = false);
     void update_url(const std::string &url);
+    /// @brief 备用源站（CDN、区域镜像、门店服务器），与主地址一起按实测速度选择，失败时切换
+    /// @param roots 与主地址相同结构的地址前缀
+    void set_mirrors(const std::vector<std::string> &roots);
+    /// @brief 下载目录磁盘配额（字节），0 为分区容量的 70%
+    void set_disk_quota(uint64_t bytes);
+    /// @brief 下载限速（总速率、单个传输、时段）
+    void set_rate_limit(const RateLimiter::Config &config);
+    /// @brief 上报 MQTT 往返时延，时延升高时自动降低下载速率
+    void report_network_rtt(int rtt_ms);
+    /// @brief 与局域网内的其他播放器互相提供已下载的文件，需在添加任务前调用
+    void enable_peer_sharing(int port = PeerCache::kDefaultPort);
+    /// @brief 接收本网段内组播推送的文件
+    void enable_multicast_push();
+    /// @brief 把已下载的文件组播推送给本网段内的所有播放器
+    /// @param rate 发送速率（字节/秒），0 使用默认值
+    bool push_asset(const std::string &name, uint64_t rate = 0);
 
 private:
     std::string url_root_;
     std::string work_dir_;
     DownloadCallback callback_;
-    std::queue<MediaItem> tasks_;
+    std::mutex callback_mutex_; // 回调串行执行
+
+    // 等待同一个文件的任务
+    struct Waiter
+    {
+        MediaItem task;
+        uint64_t epoch;
+    };
+
+    // 一个本地文件的下载，相同 MD5 的任务合并到同一个 Job
+    struct Job
+    {
+        std::string local_path;
+        std::vector<Waiter> waiters;
+        Priority priority;
+        bool running = false;
+        std::atomic<bool> cancelled{false}; // 所有等待者都已过期，中止下载
+        int attempts = 0;                    // 已失败的次数
+        std::chrono::steady_clock::time_point not_before; // 推迟重试，之前不会被领取
+        std::vector<std::string> origins;                 // 领取时熔断未打开的源站
+    };
+
+    enum class Outcome
+    {
+        Success,
+        Retry,  // 网络或服务器错误，稍后重试
+        Failed, // 重试无意义（如所有源站的文件都 MD5 不符或返回 4xx）
+    };
+
+    // 单次下载失败的原因，只有源站本身的故障计入熔断
+    enum class Failure
+    {
+        None,
+        Network,  // 连接错误或 5xx
+        Rejected, // 4xx，文件在该源站不存在或无权访问
+        Local,    // 写文件等本地错误
+    };
+
+    std::map<std::string, std::shared_ptr<Job>> jobs_;        // 本地文件 -> 排队或下载中的 Job
+    std::array<std::deque<std::shared_ptr<Job>>, 3> queues_; // 按优先级分队列，队列内先进先出
+    std::map<std::string, uint64_t> epochs_;                 // 设备当前的播放列表批次
     std::mutex queue_mutex_;
     std::condition_variable queue_cv_;
-    std::thread worker_thread_;
+    std::vector<std::thread> workers_;
+    size_t max_concurrent_;
+    size_t bulk_running_;               // 正在下载的视频/预取任务数
+    std::atomic<int> active_transfers_; // 正在下载的任务数，用于平分连接
     bool stop_flag_;
+    DownloadJournal journal_;
+    ChunkStore chunks_; // assets_ 的后台线程会生成分块清单，需在 assets_ 之后析构
+    AssetStore assets_;
+    ResourceProbe probe_;
+    RateLimiter limiter_;
+    RateLimiter lan_limiter_; // 局域网内播放器之间的传输不占外网带宽，不配置限速
+    RetryPolicy retry_;
+    CircuitBreaker breaker_;
+    std::unique_ptr<PeerCache> peers_;
+    std::unique_ptr<MulticastPush> push_;
+    std::vector<std::string> mirrors_;
+    std::mutex mirrors_mutex_;
+    std::shared_ptr<OriginSelector> origins_; // 竞速请求可能在下载器之后结束，共享所有权
 
     void worker();
-    void process_task(const MediaItem &task);
+    std::shared_ptr<Job> next_job_locked(bool &bulk);
+    std::chrono::steady_clock::time_point next_retry_locked() const;
+    std::string full_url_for(const MediaItem &task) const;
+    /// @brief 主地址和各备用源站上的下载地址，按预计下载时间排序
+    std::vector<std::string> candidate_urls(const MediaItem &task);
+    /// @brief 在排名靠前的源站上同时发起首个分段请求，最先响应的排到最前；
+    /// 同一组源站每隔一段时间才竞速一次，其余时候按测得的时延排序
+    std::vector<std::string> race_origins(std::vector<std::string> urls);
+    std::string local_path_for(const MediaItem &task) const;
+    void add_locked(const MediaItem &task, Priority priority, uint64_t epoch);
+    void drop_stale_locked(const std::string &device_id);
+    bool fetch_from_peer(const MediaItem &task, const std::string &part_path, std::string &md5,
+                         const std::atomic<bool> &cancelled);
+    Outcome process_task(const MediaItem &task, const std::vector<std::string> &urls,
+                         const std::atomic<bool> &cancelled, std::string &error_msg);
+    void notify(const MediaItem &task, const std::string &local_path, bool success, const std::string &error);
 
-    httplib::Result get_http_client(const std::string &url, int timeout = 30);
-    size_t get_file_size(const std::string &url);
-    bool download_file_multithread(const std::string &url, const std::string &local_path);
+    /// @brief 发起GET请求，提供 receiver 时响应体以流的方式交给 receiver，不在内存中保留
+    httplib::Result get_http_client(const std::string &url, int timeout = 30,
+                                    httplib::ResponseHandler response_handler = nullptr,
+                                    httplib::ContentReceiver receiver = nullptr);
+    /// @brief 探测文件大小、是否支持分段及校验信息，结果有缓存
+    bool probe_resource(const std::string &url, ResourceProbe::ResourceInfo &info);
+    /// @brief 多线程分段下载，md5 返回下载过程中计算的摘要，failure 返回失败原因
+    bool download_file_multithread(const std::string &url, const std::string &local_path, std::string &md5,
+                                   const std::atomic<bool> &cancelled, Failure &failure);
+    /// @brief 服务器提供分块清单时，用本地已有的相同块填充刚创建的下载文件
+    /// @return 已填充的区间，作为已完成进度交给分段下载
+    RangeDownloader::Ranges seed_from_chunks(const std::string &url, const std::string &local_path, int fd,
+                                             uint64_t file_size, const std::atomic<bool> &cancelled);
     /// @brief 单线程下载文件
     /// @param url
     /// @param local_path
+    /// @param md5 下载过程中计算的摘要
     /// @return
-    bool download_file(const std::string &url, const std::string &local_path);
+    /// @param cancelled 置位后中止读取
+    /// @param failure 失败原因
+    /// @param limiter 回源用 limiter_，局域网内用 lan_limiter_
+    bool download_file(const std::string &url, const std::string &local_path, std::string &md5,
+                       const std::atomic<bool> &cancelled, Failure &failure, RateLimiter &limiter);
     size_t dl_req_reply(void *buffer, size_t size, size_t nmemb, void *user_p);
     bool verify_md5(const std::string &file_path, const std::string &expected_md5);
 };
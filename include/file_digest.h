@@ -0,0 +1,75 @@
+#ifndef FILE_DIGEST_H
+#define FILE_DIGEST_H
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <functional>
+#include <atomic>
+#include <cstdint>
+#include <openssl/evp.h>
+
+/**
+ * 增量 MD5 计算
+ */
+class Md5Digest
+{
+public:
+    Md5Digest();
+    ~Md5Digest();
+
+    Md5Digest(const Md5Digest &) = delete;
+    Md5Digest &operator=(const Md5Digest &) = delete;
+
+    bool update(const void *data, size_t len);
+    // 返回小写十六进制结果，之后需 reset 才能复用
+    std::string final_hex();
+    void reset();
+
+    // 计算整个文件的 MD5，失败返回空字符串
+    // 按大块映射文件并提示内核预读，progress 在每块计算后收到本块字节数
+    // cancelled 每块检查一次，置位后中止并返回空字符串
+    static std::string file_md5(const std::string &file_path,
+                                const std::function<void(uint64_t)> &progress = nullptr,
+                                const std::atomic<bool> *cancelled = nullptr);
+
+private:
+    EVP_MD_CTX *ctx_;
+    bool ok_;
+};
+
+/**
+ * 多段并行下载的顺序 MD5
+ * 数据按偏移顺序到达时直接累加；乱序到达的区间先记录，
+ * 待前面的数据补齐后通过 reader 从刚写入的文件（页缓存）读回追平
+ */
+class OrderedDigest
+{
+public:
+    // 读取已写入磁盘的数据
+    using Reader = std::function<bool(uint64_t offset, char *buf, size_t len)>;
+
+    explicit OrderedDigest(Reader reader);
+
+    // 数据写入磁盘后调用（线程安全）
+    void on_data(uint64_t offset, const char *data, size_t len);
+    // 登记此前已在磁盘上的区间（如断点续传），轮到时从文件读回
+    void on_written(uint64_t offset, uint64_t len);
+
+    // 所有数据写完后获取结果，total_size 未全部覆盖时返回空字符串
+    std::string finish(uint64_t total_size);
+
+private:
+    // 从文件读回已可计入的区间，读取期间不持有锁
+    void catch_up(std::unique_lock<std::mutex> &lock);
+
+    Md5Digest md5_;
+    uint64_t cursor_;                    // 已计入摘要的字节数
+    std::map<uint64_t, uint64_t> pending_; // 乱序区间 起点 -> 终点
+    Reader reader_;
+    bool failed_;
+    bool catching_; // 有线程正在读回，期间只由它推进摘要
+    std::mutex mutex_;
+};
+
+#endif // FILE_DIGEST_H
@@ -0,0 +1,45 @@
+#ifndef FILE_WRITER_H
+#define FILE_WRITER_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+/**
+ * 固定缓冲区的流式文件写入
+ * 每次缓冲区落盘后通过 on_flush 交出该数据块，用于边下载边计算摘要
+ */
+class FileWriter
+{
+public:
+    // 数据块写入磁盘后的回调：文件内偏移、数据、长度
+    using FlushHandler = std::function<void(uint64_t, const char *, size_t)>;
+
+    // 每个传输的写缓冲大小，峰值内存与文件大小无关
+    static constexpr size_t kBufferSize = 256 * 1024;
+
+    // 新建（截断）文件并从头写入
+    explicit FileWriter(const std::string &path, FlushHandler on_flush = nullptr);
+    // 写入已打开的文件（不接管 fd），从 offset 开始 pwrite
+    FileWriter(int fd, uint64_t offset, FlushHandler on_flush = nullptr);
+    ~FileWriter();
+
+    FileWriter(const FileWriter &) = delete;
+    FileWriter &operator=(const FileWriter &) = delete;
+
+    bool is_open() const;
+    bool write(const char *data, size_t len);
+    bool close();
+
+private:
+    bool flush();
+
+    int fd_;
+    bool owns_fd_;
+    std::vector<char> buffer_;
+    FlushHandler on_flush_;
+    uint64_t offset_; // 缓冲区第一个字节在文件中的偏移
+};
+
+#endif // FILE_WRITER_H
@@ -0,0 +1,105 @@
+#ifndef HTTP_POOL_H
+#define HTTP_POOL_H
+
+#include <string>
+#include <map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <httplib.h>
+
+/**
+ * 按源站（协议+主机+端口）复用的 HTTP 长连接池，Downloader 和 HttpClient 共用
+ * 连接用完归还后保持 keep-alive，TLS 连接随之复用，避免重复握手；
+ * 主机名解析结果缓存，新建连接不再查询 DNS；每个源站同时使用的连接数有上限
+ */
+class HttpPool
+{
+public:
+    struct Url
+    {
+        std::string protocol;
+        std::string host;
+        int port = 80;
+        std::string path;
+
+        // 连接池键
+        std::string origin() const;
+    };
+
+    /**
+     * 借出的连接，析构时归还连接池
+     * 请求失败时调用 discard，连接不再复用
+     */
+    class Lease
+    {
+    public:
+        Lease() = default;
+        Lease(Lease &&other) noexcept;
+        Lease &operator=(Lease &&other) noexcept;
+        ~Lease();
+
+        Lease(const Lease &) = delete;
+        Lease &operator=(const Lease &) = delete;
+
+        httplib::Client *operator->() const { return client_.get(); }
+        httplib::Client &operator*() const { return *client_; }
+        explicit operator bool() const { return client_ != nullptr; }
+
+        void discard();
+
+    private:
+        friend class HttpPool;
+        Lease(HttpPool *pool, std::string origin, std::unique_ptr<httplib::Client> client);
+        void release();
+
+        HttpPool *pool_ = nullptr;
+        std::string origin_;
+        std::unique_ptr<httplib::Client> client_;
+        bool discard_ = false;
+    };
+
+    static HttpPool &instance();
+
+    // 解析URL，格式无效时抛出异常
+    static Url parse_url(const std::string &url);
+
+    /// @brief 借出一个到 url 源站的连接，达到上限时等待其他连接归还
+    /// @param read_timeout 读超时（秒）
+    Lease acquire(const Url &url, int read_timeout = 30);
+
+    void set_max_per_origin(size_t max_connections);
+
+    /// @brief 支持的压缩格式（Accept-Encoding），响应由 httplib 边接收边解压
+    /// 带 content receiver 的请求 httplib 不会自动添加此请求头，需由调用方带上；
+    /// 分段请求必须使用 identity，否则偏移对应的是压缩后的数据
+    static const std::string &accept_encoding();
+
+private:
+    struct Origin
+    {
+        std::vector<std::pair<std::unique_ptr<httplib::Client>, std::chrono::steady_clock::time_point>> idle;
+        size_t in_use = 0;
+    };
+
+    struct DnsEntry
+    {
+        std::string address;
+        std::chrono::steady_clock::time_point expires;
+    };
+
+    HttpPool();
+
+    void give_back(const std::string &origin, std::unique_ptr<httplib::Client> client, bool discard);
+    std::string resolve(const std::string &host);
+
+    std::map<std::string, Origin> origins_;
+    std::map<std::string, DnsEntry> dns_;
+    size_t max_per_origin_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+};
+
+#endif // HTTP_POOL_H
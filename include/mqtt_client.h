@@ -3,12 +3,17 @@
 
 #include <string>
 #include <functional>
+#include <map>
+#include <mutex>
+#include <chrono>
 #include <MQTTClient.h> // Paho MQTT C 头文件
 
 class mqtt_client
 {
 public:
     using MessageCallback = std::function<void(const std::string &, const std::string &)>;
+    // QoS>0 的消息从发布到服务器确认的时间
+    using RttCallback = std::function<void(int rtt_ms)>;
 
     mqtt_client(const std::string &mqtt_url,
                 const std::string &client_id,
@@ -17,6 +22,7 @@ public:
     ~mqtt_client();
 
     void setMessageCallback(MessageCallback callback);
+    void setRttCallback(RttCallback callback);
     void publish(const std::string &command, const std::string &message, int qos = 1);
     bool isConnected() const;
     void disconnect();
@@ -35,6 +41,9 @@ private:
     std::string account_;
     std::string password_;
     MessageCallback message_callback_;
+    RttCallback rtt_callback_;
+    std::map<MQTTClient_deliveryToken, std::chrono::steady_clock::time_point> in_flight_; // 等待确认的消息
+    std::mutex in_flight_mutex_;
     MQTTClient client_; // 明确使用全局命名空间的MQTTClient
     MQTTClient_connectOptions conn_opts_;
 };
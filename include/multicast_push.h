@@ -0,0 +1,117 @@
+#ifndef MULTICAST_PUSH_H
+#define MULTICAST_PUSH_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <set>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+#include <random>
+
+/**
+ * 组播推送资源文件
+ * 发送端（指定的播放器或管理工具）把文件按编号分块组播到本网段，每 16 块附带一个异或校验块，
+ * 每组丢失一块时接收端可自行恢复；每轮发送结束后接收端把仍缺少的块编号单播回发送端（NACK），
+ * 发送端只重发缺失的块，直到没有接收端再报告缺失。所有播放器同时收齐，一份流量覆盖整个门店
+ *
+ * 报文（网络字节序）：magic "EPMP" | type(1) | 保留(1) | 长度(2) | 会话(4) | 文件大小(8) | 编号(4) |
+ * NACK 端口(2) | 文件名(48，不足补 0) | 数据
+ * type 1 数据块（编号为块号），2 校验块（编号为组号），3 本轮结束（编号为轮次）
+ * NACK：magic "EPMN" | 会话(4) | 缺失的块号(4) * n
+ */
+class MulticastPush
+{
+public:
+    // 是否接收该文件（已有校验过的同名文件时不再接收）
+    using WantCheck = std::function<bool(const std::string &name)>;
+    // 文件已收齐、校验并发布到下载目录
+    using ReceivedHandler = std::function<void(const std::string &name, const std::string &md5)>;
+
+    MulticastPush(const std::string &dir, WantCheck want, ReceivedHandler on_received);
+    ~MulticastPush();
+
+    MulticastPush(const MulticastPush &) = delete;
+    MulticastPush &operator=(const MulticastPush &) = delete;
+
+    /// @brief 排队组播下载目录中的文件，rate 为发送速率（字节/秒），0 使用默认值
+    void push(const std::string &name, uint64_t rate = 0);
+
+private:
+    // 接收中的文件
+    struct Incoming
+    {
+        std::string name;
+        uint64_t size = 0;
+        uint32_t chunks = 0;
+        uint32_t received = 0;
+        std::vector<bool> have;
+        std::map<uint32_t, std::string> parity; // 组号 -> 校验块，组收齐后释放
+        int fd = -1;
+        std::string sender;                     // 发送端地址，NACK 单播回去
+        uint16_t nack_port = 0;
+        uint32_t nacked_round = UINT32_MAX;     // 每轮只报告一次缺失
+        bool nack_pending = false;
+        std::chrono::steady_clock::time_point nack_due; // 随机延后报告，避免所有播放器同时发送
+        std::chrono::steady_clock::time_point last_packet;
+    };
+
+    struct Outgoing
+    {
+        std::string name;
+        uint64_t rate;
+    };
+
+    // 已收齐、等待校验发布的文件
+    struct Received
+    {
+        uint32_t session;
+        std::string name;
+    };
+
+    void receive_loop();
+    void send_loop();
+    bool send_file(const Outgoing &job);
+    void handle_packet(const uint8_t *data, size_t len, const std::string &sender);
+    void store_chunk(Incoming &in, uint32_t index, const uint8_t *data, size_t len);
+    void try_recover(Incoming &in, uint32_t group);
+    void finish(uint32_t session, Incoming &in);
+    void verify_loop();
+    void verify(const Received &file);
+    void send_nack(uint32_t session, Incoming &in);
+    void abandon(Incoming &in);
+    size_t chunk_length(const Incoming &in, uint32_t index) const;
+    static bool valid_name(const std::string &name);
+
+    std::string dir_;
+    WantCheck want_;
+    ReceivedHandler on_received_;
+
+    std::map<uint32_t, Incoming> incoming_; // 会话 -> 接收中的文件，只在接收线程访问
+    std::set<uint32_t> finished_;           // 已完成或忽略的会话，不再处理后续报文
+    int socket_fd_;
+    std::mt19937 rng_;
+
+    std::deque<Outgoing> outgoing_;
+    std::mutex send_mutex_;
+    std::condition_variable send_cv_;
+
+    // 整文件 MD5 在校验线程计算，不阻塞接收，避免其他会话丢包
+    std::deque<Received> received_;
+    std::set<std::string> verifying_; // 排队或校验中的文件名，期间忽略同名文件的新推送
+    std::mutex verify_mutex_;
+    std::condition_variable verify_cv_;
+
+    std::atomic<bool> stop_;
+    std::thread receive_thread_;
+    std::thread send_thread_;
+    std::thread verify_thread_;
+};
+
+#endif // MULTICAST_PUSH_H
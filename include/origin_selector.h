@@ -0,0 +1,49 @@
+#ifndef ORIGIN_SELECTOR_H
+#define ORIGIN_SELECTOR_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+
+/**
+ * 源站选择
+ * 按源站（协议+主机+端口）记录实测的首字节时延和下载吞吐（指数平滑），
+ * 用预计下载时间对候选地址排序；连续失败的源站排到后面，成功一次后恢复
+ */
+class OriginSelector
+{
+public:
+    void report_latency(const std::string &origin, double latency_ms);
+    // 只统计足够大的传输，小文件的耗时主要是时延
+    void report_transfer(const std::string &origin, uint64_t bytes, double seconds);
+    void report_failure(const std::string &origin);
+
+    /// @brief 按预计下载时间从短到长排序，未测量过的源站按默认值估计，相同时保持原有顺序
+    /// @param urls 完整下载地址
+    /// @param expected_bytes 预计的文件大小
+    void rank(std::vector<std::string> &urls, uint64_t expected_bytes);
+
+    /// @brief 这组源站是否需要竞速：从未竞速过或距上次已超过一段时间，返回 true 时即登记本次竞速；
+    /// 同一组源站的竞速结果已计入时延统计，之后的下载按 rank 排序即可
+    /// @param origins 协议+主机+端口，与顺序无关
+    bool begin_race(std::vector<std::string> origins);
+
+private:
+    struct Stats
+    {
+        double latency_ms = -1;    // 未测量为负
+        double bytes_per_sec = -1; // 未测量为负
+        int failures = 0;          // 连续失败次数
+    };
+
+    double estimate_locked(const std::string &origin, uint64_t bytes) const;
+
+    std::map<std::string, Stats> stats_;
+    std::map<std::string, std::chrono::steady_clock::time_point> races_; // 源站组合 -> 上次竞速时间
+    std::mutex mutex_;
+};
+
+#endif // ORIGIN_SELECTOR_H
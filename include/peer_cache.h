@@ -0,0 +1,75 @@
+#ifndef PEER_CACHE_H
+#define PEER_CACHE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <cstdint>
+#include <httplib.h>
+
+/**
+ * 局域网播放器之间共享已下载的资源
+ * 每个播放器定期向组播组通告自己可提供的文件（文件名的布隆过滤器）和服务端口，
+ * 并用内置的 HTTP 服务提供校验过的文件；下载前先查找可能有该文件的播放器，
+ * 同一门店的资源只需从服务器下载一份
+ */
+class PeerCache
+{
+public:
+    static constexpr int kDefaultPort = 9004;
+
+    // 当前可共享的文件名（已校验）
+    using ListHandler = std::function<std::vector<std::string>()>;
+    // 请求到达时确认文件仍完整可用
+    using ServeCheck = std::function<bool(const std::string &name)>;
+
+    PeerCache(const std::string &dir, ListHandler list, ServeCheck can_serve, int port = kDefaultPort);
+    ~PeerCache();
+
+    PeerCache(const PeerCache &) = delete;
+    PeerCache &operator=(const PeerCache &) = delete;
+
+    /// @brief 可能有该文件的播放器上的下载地址，最近通告的在前
+    std::vector<std::string> locate(const std::string &name);
+
+private:
+    struct Peer
+    {
+        std::string address;
+        int port = 0;
+        std::vector<uint8_t> bloom;
+        std::chrono::steady_clock::time_point last_seen;
+    };
+
+    void announce_loop();
+    void listen_loop();
+    void handle_announcement(const std::string &message, const std::string &address);
+    static std::vector<uint8_t> make_bloom(const std::vector<std::string> &names);
+    static bool bloom_contains(const std::vector<uint8_t> &bloom, const std::string &name);
+    static bool valid_name(const std::string &name);
+
+    std::string dir_;
+    ListHandler list_;
+    ServeCheck can_serve_;
+    int port_;
+    std::string instance_id_; // 区分收到的是否是自己的通告
+
+    std::map<std::string, Peer> peers_; // 实例 ID -> 播放器
+    std::mutex mutex_;
+
+    httplib::Server server_;
+    bool serving_;
+    int socket_fd_;
+    std::atomic<bool> stop_;
+    std::atomic<bool> announce_now_; // 发现新播放器后立即通告，不等下一个周期
+    std::thread server_thread_;
+    std::thread announce_thread_;
+    std::thread listen_thread_;
+};
+
+#endif // PEER_CACHE_H
@@ -0,0 +1,103 @@
+#ifndef RANGE_DOWNLOADER_H
+#define RANGE_DOWNLOADER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <list>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include <httplib.h>
+#include "file_digest.h"
+#include "http_pool.h"
+
+/**
+ * 单文件并行分段下载
+ * 多个工作线程从共享的区间队列领取分块，用 pwrite 直接写入预分配的目标文件；
+ * 分块大小按各线程实测速度调整，线程数在吞吐仍有提升时逐步增加；
+ * 队列取空后空闲线程会拆分剩余最多的在途区间，失败时只重试未完成的部分；
+ * 已落盘的区间定期 fdatasync 后通过 checkpoint 交给调用方保存，用于断点续传
+ */
+class RangeDownloader
+{
+public:
+    using ClientFactory = std::function<HttpPool::Lease()>;
+    using Ranges = std::vector<std::pair<uint64_t, uint64_t>>;
+    // 已落盘区间及服务器校验信息（ETag / Last-Modified）
+    using Checkpoint = std::function<void(const Ranges &done, const std::string &etag, const std::string &last_modified)>;
+
+    RangeDownloader(ClientFactory factory, const std::string &path, uint64_t file_size);
+
+    /// @brief 从上次进度继续，校验信息不一致时视为文件已变更
+    void resume(const Ranges &done, const std::string &etag, const std::string &last_modified);
+    void set_checkpoint(Checkpoint checkpoint);
+    /// @brief 线程数上限，随时可能变化（如并发的传输数），用于在多个传输间分配连接
+    void set_worker_limit(std::function<int()> limit);
+    /// @brief 置位后中止所有分段读取，已完成的进度照常保存
+    void set_cancel_flag(const std::atomic<bool> *cancelled);
+    /// @brief 每收到一段数据前调用，用于限速；返回 false 中止读取
+    void set_throttle(std::function<bool(size_t len)> throttle);
+
+    /// @brief 下载到已打开（并预分配）的 fd
+    /// @param fd 目标文件
+    /// @param md5 下载过程中计算的摘要
+    /// @return 全部区间完成返回 true
+    bool run(int fd, std::string &md5);
+
+    /// @brief 服务器上的文件在续传期间发生了变化，已有进度作废
+    bool changed() const;
+
+private:
+    // 正在下载的区间 [cursor, limit)，limit 可能被空闲线程拆走后半段
+    struct Slot
+    {
+        uint64_t cursor = 0;
+        uint64_t limit = 0;
+        bool active = false;
+    };
+
+    void worker();
+    bool take_range(Slot &slot, uint64_t chunk_size);
+    bool has_work();
+    bool fetch(httplib::Client &client, Slot &slot);
+    void start_worker();
+    int worker_limit() const;
+    bool check_validator(const httplib::Response &response);
+    void add_done(uint64_t start, uint64_t end);
+    void save_checkpoint(std::unique_lock<std::mutex> &lock);
+
+    ClientFactory factory_;
+    std::string path_;
+    uint64_t file_size_;
+    int fd_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::pair<uint64_t, uint64_t>> pending_; // 待下载区间 [start, end)
+    std::list<Slot> slots_;
+    std::vector<std::thread> threads_;
+    int running_;
+    int failures_;
+    bool failed_;
+    bool changed_;
+    bool trimmed_; // 有线程因上限降低而退出
+    std::function<int()> worker_limit_;
+    const std::atomic<bool> *cancelled_;
+    std::function<bool(size_t)> throttle_;
+
+    std::map<uint64_t, uint64_t> done_; // 已落盘区间 起点 -> 终点
+    bool done_dirty_;
+    std::string etag_;
+    std::string last_modified_;
+    Checkpoint checkpoint_;
+
+    std::atomic<uint64_t> received_;
+    std::unique_ptr<OrderedDigest> digest_;
+};
+
+#endif // RANGE_DOWNLOADER_H
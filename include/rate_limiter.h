@@ -0,0 +1,106 @@
+#ifndef RATE_LIMITER_H
+#define RATE_LIMITER_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/**
+ * 令牌桶，速率单位字节/秒，允许透支：取出令牌后按欠额计算需要等待的时间，
+ * 大块数据不会一直等不到足够的令牌
+ */
+class TokenBucket
+{
+public:
+    explicit TokenBucket(uint64_t rate = 0);
+
+    // 0 表示不限速
+    void set_rate(uint64_t rate);
+    // 取出 bytes 个令牌，返回发送前需要等待的时间
+    std::chrono::microseconds take(size_t bytes);
+
+private:
+    uint64_t rate_;
+    double tokens_;
+    std::chrono::steady_clock::time_point last_;
+    std::mutex mutex_;
+};
+
+/**
+ * 下载限速
+ * 全局令牌桶限制所有下载的总速率，每个传输另有自己的令牌桶；
+ * 全局速率可按时段配置（如营业时间限速、夜间不限速），
+ * MQTT 往返时延明显升高时按比例降低全局速率，恢复后逐步放开
+ */
+class RateLimiter
+{
+public:
+    // 时段 [start_minute, end_minute)，按当天分钟数，可跨零点
+    struct Window
+    {
+        int start_minute = 0;
+        int end_minute = 0;
+        uint64_t rate = 0;
+    };
+
+    struct Config
+    {
+        uint64_t global_rate = 0;   // 字节/秒，0 不限速
+        uint64_t transfer_rate = 0; // 单个传输的上限
+        std::vector<Window> schedule;
+    };
+
+    // 一次下载的限速，构造时登记为活动传输，同一传输的多个分段线程共用
+    class Transfer
+    {
+    public:
+        explicit Transfer(RateLimiter &limiter);
+        ~Transfer();
+
+        Transfer(const Transfer &) = delete;
+        Transfer &operator=(const Transfer &) = delete;
+
+        // 等待到可以处理 bytes 字节，等待期间被取消返回 false
+        bool acquire(size_t bytes, const std::atomic<bool> *cancelled = nullptr);
+
+    private:
+        RateLimiter &limiter_;
+        TokenBucket bucket_;
+    };
+
+    RateLimiter();
+
+    void configure(const Config &config);
+    // MQTT 消息发布到确认的时间
+    void report_rtt(int rtt_ms);
+
+    // 解析 "08:00-22:00=256;22:00-08:00=0"，速率单位 KB/s
+    static bool parse_schedule(const std::string &text, std::vector<Window> &schedule);
+
+private:
+    std::chrono::microseconds take_global(size_t bytes);
+    void update_rate_locked();
+
+    Config config_;
+    TokenBucket global_;
+    std::atomic<uint64_t> transfer_rate_;
+    std::atomic<int> active_;
+
+    // 时延退避
+    double factor_;        // 全局速率的比例，1 为不退避
+    double srtt_;          // 平滑后的往返时延
+    double base_rtt_;      // 空闲时的基准时延
+    uint64_t backoff_base_; // 未配置限速时以退避开始时的实测速率为基准
+    uint64_t window_bytes_;
+    std::chrono::steady_clock::time_point window_start_;
+    uint64_t observed_rate_;
+
+    uint64_t rate_;
+    std::chrono::steady_clock::time_point rate_updated_;
+    std::mutex mutex_;
+};
+
+#endif // RATE_LIMITER_H
@@ -0,0 +1,54 @@
+#ifndef RESOURCE_PROBE_H
+#define RESOURCE_PROBE_H
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include <httplib.h>
+
+/**
+ * 远程文件能力探测
+ * 用 HEAD 或 Range: bytes=0-0 获取大小、是否支持分段及校验信息，不传输文件内容；
+ * 结果按 URL 缓存，服务器是否支持 HEAD 按主机缓存
+ */
+class ResourceProbe
+{
+public:
+    struct ResourceInfo
+    {
+        uint64_t size = 0;
+        bool accept_ranges = false;
+        std::string etag;
+        std::string last_modified;
+        int status = 0; // 探测失败时最后一次响应的状态码，未收到响应为 0
+    };
+
+    /// @brief 探测远程文件
+    /// @param url 完整地址，缓存键
+    /// @param origin 协议+主机+端口，主机能力缓存键
+    /// @param client 已连接到 origin 的客户端
+    /// @param path 请求路径
+    bool probe(const std::string &url, const std::string &origin,
+               httplib::Client &client, const std::string &path, ResourceInfo &info);
+
+    // 下载失败或文件变更后清除缓存
+    void invalidate(const std::string &url);
+
+private:
+    struct CacheEntry
+    {
+        ResourceInfo info;
+        std::chrono::steady_clock::time_point time;
+    };
+
+    bool probe_head(httplib::Client &client, const std::string &path, ResourceInfo &info, bool &head_supported);
+    bool probe_range(httplib::Client &client, const std::string &path, ResourceInfo &info);
+
+    std::map<std::string, CacheEntry> resources_;
+    std::map<std::string, bool> head_supported_;
+    std::mutex mutex_;
+};
+
+#endif // RESOURCE_PROBE_H
@@ -0,0 +1,72 @@
+#ifndef RETRY_POLICY_H
+#define RETRY_POLICY_H
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <random>
+#include <chrono>
+
+/**
+ * 失败重试的等待时间：按次数指数增长并加入随机抖动，
+ * 服务器故障恢复时大量设备不会在同一时刻一起重试
+ */
+class RetryPolicy
+{
+public:
+    RetryPolicy(int max_attempts = 5,
+                std::chrono::milliseconds base = std::chrono::seconds(2),
+                std::chrono::milliseconds cap = std::chrono::minutes(5));
+
+    // 已失败 attempts 次后是否还能重试
+    bool should_retry(int attempts) const { return attempts < max_attempts_; }
+    // 第 attempts 次失败后的等待时间，在 base * 2^(attempts-1)（不超过 cap）的一半到全部之间随机
+    std::chrono::milliseconds delay(int attempts);
+
+private:
+    int max_attempts_;
+    std::chrono::milliseconds base_;
+    std::chrono::milliseconds cap_;
+    std::mt19937 rng_;
+    std::mutex mutex_;
+};
+
+/**
+ * 按服务器（协议+主机+端口）的熔断器
+ * 连续失败达到阈值后断开一段时间，期间不再请求该服务器；
+ * 时间到后只放行一个探测请求，成功则恢复，失败则加倍断开时间
+ */
+class CircuitBreaker
+{
+public:
+    CircuitBreaker();
+
+    // 返回 0 表示可以请求，否则为还需等待的时间
+    std::chrono::milliseconds check(const std::string &origin);
+    void record_success(const std::string &origin);
+    void record_failure(const std::string &origin);
+
+private:
+    enum class State
+    {
+        Closed,
+        Open,
+        HalfOpen
+    };
+
+    struct Entry
+    {
+        State state = State::Closed;
+        int failures = 0;
+        std::chrono::milliseconds cooldown{0};
+        std::chrono::steady_clock::time_point until; // Open：断开结束时间；HalfOpen：探测超时时间
+    };
+
+    std::chrono::milliseconds jittered(std::chrono::milliseconds value);
+
+    std::map<std::string, Entry> entries_;
+    std::mt19937 rng_;
+    std::mutex mutex_;
+};
+
+#endif // RETRY_POLICY_H
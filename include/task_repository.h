@@ -4,6 +4,7 @@
 #include <string>
 #include <memory>
 #include <vector>
+#include <map>
 
 struct MediaItem
 {
@@ -15,7 +16,7 @@ struct MediaItem
     int index;
     int left;
     int top;
-    int type; // 0 image 1 video
+    int type; // 0 image 1 video 2 template
     int width;
     int height;
     std::string MD5;
@@ -42,6 +43,9 @@ public:
     std::string saveTask(std::string data);
     std::vector<std::unique_ptr<MediaItem>> getPlayList(const std::string &device_id);
     std::string getTaskId(std::string device_id);
+    // 保存模板字段值，返回设备id，fields 输出本次更新的字段
+    std::string saveFields(std::string data, std::map<std::string, std::string> &fields);
+    std::map<std::string, std::string> getFields(const std::string &device_id);
 
 private:
     void saveTaskId(std::string device_id, std::string task_id);
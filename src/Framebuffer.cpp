@@ -4,6 +4,84 @@
 #include <linux/fb.h>
 #include <algorithm>
 #include <iostream>
+#include <cstring>
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+    // (x + 128) / 255 的近似整数除法，结果与四舍五入一致
+    inline uint8_t div255(uint32_t x)
+    {
+        x += 128;
+        return static_cast<uint8_t>((x + (x >> 8)) >> 8);
+    }
+
+    inline uint8_t blend_channel(uint8_t src, uint8_t dst, uint32_t alpha)
+    {
+        return div255(src * alpha + dst * (255 - alpha));
+    }
+
+#if defined(__ARM_NEON)
+    inline uint8x8_t div255_u16(uint16x8_t x)
+    {
+        uint16x8_t t = vaddq_u16(x, vdupq_n_u16(128));
+        return vaddhn_u16(t, vshrq_n_u16(t, 8));
+    }
+
+    inline uint8x8_t blend_u8(uint8x8_t src, uint8x8_t dst, uint8x8_t alpha, uint8x8_t inv_alpha)
+    {
+        return div255_u16(vmlal_u8(vmull_u8(src, alpha), dst, inv_alpha));
+    }
+#endif
+
+    /**
+     * 32位格式单行掩码混合，内存字节序为 B G R A
+     */
+    void blend_mask_row32(uint8_t *dst, const uint8_t *mask, int count,
+                          uint8_t r, uint8_t g, uint8_t b, uint8_t color_alpha)
+    {
+        int i = 0;
+#if defined(__ARM_NEON)
+        const uint8x8_t vr = vdup_n_u8(r);
+        const uint8x8_t vg = vdup_n_u8(g);
+        const uint8x8_t vb = vdup_n_u8(b);
+        const uint8x8_t v255 = vdup_n_u8(0xFF);
+        const uint8x8_t vca = vdup_n_u8(color_alpha);
+        for (; i + 8 <= count; i += 8)
+        {
+            uint8x8_t a = vld1_u8(mask + i);
+            if (vget_lane_u64(vreinterpret_u64_u8(a), 0) == 0)
+                continue;
+            if (color_alpha != 0xFF)
+                a = div255_u16(vmull_u8(a, vca));
+
+            const uint8x8_t ia = vmvn_u8(a);
+            uint8x8x4_t px = vld4_u8(dst + i * 4);
+            px.val[0] = blend_u8(vb, px.val[0], a, ia);
+            px.val[1] = blend_u8(vg, px.val[1], a, ia);
+            px.val[2] = blend_u8(vr, px.val[2], a, ia);
+            px.val[3] = blend_u8(v255, px.val[3], a, ia);
+            vst4_u8(dst + i * 4, px);
+        }
+#endif
+        for (; i < count; ++i)
+        {
+            uint32_t a = mask[i];
+            if (a == 0)
+                continue;
+            if (color_alpha != 0xFF)
+                a = div255(a * color_alpha);
+
+            uint8_t *p = dst + i * 4;
+            p[0] = blend_channel(b, p[0], a);
+            p[1] = blend_channel(g, p[1], a);
+            p[2] = blend_channel(r, p[2], a);
+            p[3] = blend_channel(0xFF, p[3], a);
+        }
+    }
+}
 
 /**
  * 将像素绘制到 Framebuffer（支持alpha混合）
@@ -250,4 +328,162 @@ void Framebuffer::draw_image_to_framebuffer(uint8_t *fb_ptr, const fb_var_screen
             draw_to_framebuffer(fb_ptr, vinfo, offset_x + x, offset_y + y, pixel);
         }
     }
-}
\ No newline at end of file
+}
+
+/**
+ * 将 A8 覆盖率掩码着色后直接混合到 Framebuffer
+ */
+void Framebuffer::draw_mask_to_framebuffer(uint8_t *fb_ptr, const fb_var_screeninfo &vinfo,
+                                           const uint8_t *mask, int mask_width, int mask_height, int mask_stride,
+                                           int offset_x, int offset_y, uint32_t color)
+{
+    if (!fb_ptr || !mask || mask_width <= 0 || mask_height <= 0)
+        return;
+
+    // 裁剪到屏幕可见区域
+    const int x0 = std::max(offset_x, 0);
+    const int y0 = std::max(offset_y, 0);
+    const int x1 = std::min<int>(offset_x + mask_width, vinfo.xres);
+    const int y1 = std::min<int>(offset_y + mask_height, vinfo.yres);
+    if (x0 >= x1 || y0 >= y1)
+        return;
+
+    const uint8_t color_alpha = (color >> 24) & 0xFF;
+    if (color_alpha == 0)
+        return;
+
+    const uint8_t r = (color >> 16) & 0xFF;
+    const uint8_t g = (color >> 8) & 0xFF;
+    const uint8_t b = color & 0xFF;
+    const size_t fb_row_bytes = vinfo.xres * (vinfo.bits_per_pixel / 8);
+
+    for (int y = y0; y < y1; ++y)
+    {
+        const uint8_t *mask_row = mask + (y - offset_y) * mask_stride + (x0 - offset_x);
+
+        if (vinfo.bits_per_pixel == 32)
+        {
+            blend_mask_row32(fb_ptr + y * fb_row_bytes + x0 * 4, mask_row, x1 - x0, r, g, b, color_alpha);
+            continue;
+        }
+
+        // 其他格式逐像素混合
+        for (int x = x0; x < x1; ++x)
+        {
+            uint32_t a = mask_row[x - x0];
+            if (a == 0)
+                continue;
+            if (color_alpha != 0xFF)
+                a = div255(a * color_alpha);
+            draw_to_framebuffer(fb_ptr, vinfo, x, y, (a << 24) | (color & 0x00FFFFFF));
+        }
+    }
+}
+
+/**
+ * 纯色填充矩形区域
+ */
+void Framebuffer::fill_rect(uint8_t *fb_ptr, const fb_var_screeninfo &vinfo,
+                            int x, int y, int width, int height, uint32_t color)
+{
+    if (!fb_ptr)
+        return;
+
+    const int x0 = std::max(x, 0);
+    const int y0 = std::max(y, 0);
+    const int x1 = std::min<int>(x + width, vinfo.xres);
+    const int y1 = std::min<int>(y + height, vinfo.yres);
+    if (x0 >= x1 || y0 >= y1)
+        return;
+
+    const uint8_t alpha = (color >> 24) & 0xFF;
+    if (alpha == 0)
+        return;
+
+    const size_t fb_row_bytes = vinfo.xres * (vinfo.bits_per_pixel / 8);
+
+    // 不透明的 16/32 位格式按整行填充
+    if (alpha == 0xFF && vinfo.bits_per_pixel == 32)
+    {
+        for (int row = y0; row < y1; ++row)
+        {
+            uint32_t *dst = reinterpret_cast<uint32_t *>(fb_ptr + row * fb_row_bytes) + x0;
+            std::fill_n(dst, x1 - x0, color);
+        }
+        return;
+    }
+    if (alpha == 0xFF && vinfo.bits_per_pixel == 16)
+    {
+        const uint16_t rgb565 = ((color >> 8) & 0xF800) | ((color >> 5) & 0x07E0) | ((color >> 3) & 0x001F);
+        for (int row = y0; row < y1; ++row)
+        {
+            uint16_t *dst = reinterpret_cast<uint16_t *>(fb_ptr + row * fb_row_bytes) + x0;
+            std::fill_n(dst, x1 - x0, rgb565);
+        }
+        return;
+    }
+
+    for (int row = y0; row < y1; ++row)
+    {
+        for (int col = x0; col < x1; ++col)
+        {
+            draw_to_framebuffer(fb_ptr, vinfo, col, row, color);
+        }
+    }
+}
+
+/**
+ * 保存矩形区域的原始像素
+ */
+void Framebuffer::save_region(const uint8_t *fb_ptr, const fb_var_screeninfo &vinfo,
+                              int x, int y, int width, int height, std::vector<uint8_t> &out)
+{
+    out.clear();
+    if (!fb_ptr)
+        return;
+
+    const int x0 = std::max(x, 0);
+    const int y0 = std::max(y, 0);
+    const int x1 = std::min<int>(x + width, vinfo.xres);
+    const int y1 = std::min<int>(y + height, vinfo.yres);
+    if (x0 >= x1 || y0 >= y1)
+        return;
+
+    const size_t bytes_per_pixel = vinfo.bits_per_pixel / 8;
+    const size_t fb_row_bytes = vinfo.xres * bytes_per_pixel;
+    const size_t row_bytes = (x1 - x0) * bytes_per_pixel;
+    out.resize(row_bytes * (y1 - y0));
+
+    for (int row = y0; row < y1; ++row)
+    {
+        memcpy(out.data() + (row - y0) * row_bytes, fb_ptr + row * fb_row_bytes + x0 * bytes_per_pixel, row_bytes);
+    }
+}
+
+/**
+ * 恢复 save_region 保存的像素
+ */
+void Framebuffer::restore_region(uint8_t *fb_ptr, const fb_var_screeninfo &vinfo,
+                                 int x, int y, int width, int height, const std::vector<uint8_t> &data)
+{
+    if (!fb_ptr || data.empty())
+        return;
+
+    const int x0 = std::max(x, 0);
+    const int y0 = std::max(y, 0);
+    const int x1 = std::min<int>(x + width, vinfo.xres);
+    const int y1 = std::min<int>(y + height, vinfo.yres);
+    if (x0 >= x1 || y0 >= y1)
+        return;
+
+    const size_t bytes_per_pixel = vinfo.bits_per_pixel / 8;
+    const size_t fb_row_bytes = vinfo.xres * bytes_per_pixel;
+    const size_t row_bytes = (x1 - x0) * bytes_per_pixel;
+    if (data.size() < row_bytes * (y1 - y0))
+        return;
+
+    for (int row = y0; row < y1; ++row)
+    {
+        memcpy(fb_ptr + row * fb_row_bytes + x0 * bytes_per_pixel, data.data() + (row - y0) * row_bytes, row_bytes);
+    }
+}
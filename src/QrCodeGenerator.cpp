@@ -1,6 +1,6 @@
 #include "QrCodeGenerator.h"
+#include "Framebuffer.h"
 #include <qrencode.h>
-#include <png.h>
 #include <ImageDecoder.h>
 #include <vector>
 
@@ -8,15 +8,34 @@
 #include <vector>
 #include <cstring>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <algorithm>
 
-ImageData QrCodeGenerator::generate(
+namespace
+{
+    // 缓存上限，超出后整体清空
+    constexpr size_t kMaxCachedCodes = 16;
+
+    std::mutex g_cache_mutex;
+    std::map<std::string, std::shared_ptr<const QrCodeGenerator::Matrix>> g_cache;
+}
+
+std::shared_ptr<const QrCodeGenerator::Matrix> QrCodeGenerator::encode(
     const std::string &text,
-    int size,
     int margin,
-    uint32_t fg_color,
-    uint32_t bg_color,
     ErrorCorrection level)
 {
+    const std::string key = std::to_string(static_cast<int>(level)) + ',' + std::to_string(margin) + ',' + text;
+    {
+        std::lock_guard<std::mutex> lock(g_cache_mutex);
+        auto it = g_cache.find(key);
+        if (it != g_cache.end())
+        {
+            return it->second;
+        }
+    }
+
     // 1. 生成QR码
     QRcode *qr = QRcode_encodeString(
         text.c_str(),
@@ -31,54 +50,130 @@ ImageData QrCodeGenerator::generate(
         throw std::runtime_error("Failed to generate QR code");
     }
 
-    // 2. 计算图像尺寸
-    const int qr_width = qr->width + 2 * margin;
-    const int img_width = qr_width * size;
-    const int img_height = qr_width * size;
+    // 2. 打包为 1-bit 矩阵（含边距）
+    auto matrix = std::make_shared<Matrix>();
+    matrix->width = qr->width + 2 * margin;
+    matrix->row_bytes = (matrix->width + 7) / 8;
+    matrix->bits.assign(matrix->row_bytes * matrix->width, 0);
+
+    for (int y = 0; y < qr->width; ++y)
+    {
+        uint8_t *row = matrix->bits.data() + (y + margin) * matrix->row_bytes;
+        for (int x = 0; x < qr->width; ++x)
+        {
+            if (qr->data[y * qr->width + x] & 1)
+            {
+                const int mx = x + margin;
+                row[mx >> 3] |= 0x80 >> (mx & 7);
+            }
+        }
+    }
+    QRcode_free(qr);
+
+    std::lock_guard<std::mutex> lock(g_cache_mutex);
+    if (g_cache.size() >= kMaxCachedCodes)
+    {
+        g_cache.clear();
+    }
+    g_cache[key] = matrix;
+    return matrix;
+}
+
+void QrCodeGenerator::draw(uint8_t *fb_ptr, const fb_var_screeninfo &vinfo, const Matrix &qr,
+                           int x, int y, int size, uint32_t fg_color, uint32_t bg_color)
+{
+    if (!fb_ptr || qr.width <= 0 || size <= 0)
+        return;
+
+    // RGBA -> ARGB
+    const uint32_t fg = (fg_color << 24) | (fg_color >> 8);
+    const uint32_t bg = (bg_color << 24) | (bg_color >> 8);
+    const int img_size = qr.width * size;
+
+    // 完全位于屏幕内、32位且两色均不透明：展开一行后整行复制
+    const bool fast = vinfo.bits_per_pixel == 32 && (fg >> 24) == 0xFF && (bg >> 24) == 0xFF &&
+                      x >= 0 && y >= 0 && x + img_size <= static_cast<int>(vinfo.xres) &&
+                      y + img_size <= static_cast<int>(vinfo.yres);
+    const size_t fb_row_bytes = vinfo.xres * (vinfo.bits_per_pixel / 8);
+
+    for (int my = 0; my < qr.width; ++my)
+    {
+        const int py = y + my * size;
+
+        // 按相同颜色的连续模块分段填充
+        int run_start = 0;
+        while (run_start < qr.width)
+        {
+            const bool on = qr.module(run_start, my);
+            int run_end = run_start + 1;
+            while (run_end < qr.width && qr.module(run_end, my) == on)
+                ++run_end;
+
+            const int px = x + run_start * size;
+            const int run_width = (run_end - run_start) * size;
+            if (fast)
+            {
+                uint32_t *dst = reinterpret_cast<uint32_t *>(fb_ptr + py * fb_row_bytes) + px;
+                std::fill_n(dst, run_width, on ? fg : bg);
+            }
+            else
+            {
+                Framebuffer::fill_rect(fb_ptr, vinfo, px, py, run_width, size, on ? fg : bg);
+            }
+            run_start = run_end;
+        }
+
+        // 模块行的其余像素行与第一行相同
+        if (fast)
+        {
+            const uint8_t *src = fb_ptr + py * fb_row_bytes + x * 4;
+            for (int dy = 1; dy < size; ++dy)
+            {
+                memcpy(fb_ptr + (py + dy) * fb_row_bytes + x * 4, src, img_size * 4);
+            }
+        }
+    }
+}
+
+ImageData QrCodeGenerator::generate(
+    const std::string &text,
+    int size,
+    int margin,
+    uint32_t fg_color,
+    uint32_t bg_color,
+    ErrorCorrection level)
+{
+    std::shared_ptr<const Matrix> qr = encode(text, margin, level);
 
-    // 3. 准备图像数据 (RGBA格式)
+    // 1. 准备图像数据 (RGBA格式)
+    const int img_width = qr->width * size;
     ImageData result;
     result.width = img_width;
-    result.height = img_height;
+    result.height = img_width;
     result.channels = 4; // 强制使用RGBA
-    result.pixels.resize(img_width * img_height * 4);
+    result.pixels.resize(img_width * img_width * 4);
 
-    // 4. 填充背景色
-    for (int i = 0; i < img_width * img_height; ++i)
-    {
-        result.pixels[i * 4 + 0] = (bg_color >> 24) & 0xFF; // R
-        result.pixels[i * 4 + 1] = (bg_color >> 16) & 0xFF; // G
-        result.pixels[i * 4 + 2] = (bg_color >> 8) & 0xFF;  // B
-        result.pixels[i * 4 + 3] = bg_color & 0xFF;         // A
-    }
+    const uint8_t fg[4] = {uint8_t(fg_color >> 24), uint8_t(fg_color >> 16), uint8_t(fg_color >> 8), uint8_t(fg_color)};
+    const uint8_t bg[4] = {uint8_t(bg_color >> 24), uint8_t(bg_color >> 16), uint8_t(bg_color >> 8), uint8_t(bg_color)};
 
-    // 5. 绘制QR模块（带放大效果）
-    for (int y = 0; y < qr->width; ++y)
+    // 2. 逐模块行展开第一行像素，再整行复制
+    const size_t row_bytes = img_width * 4;
+    for (int my = 0; my < qr->width; ++my)
     {
-        for (int x = 0; x < qr->width; ++x)
+        uint8_t *row = result.pixels.data() + my * size * row_bytes;
+        for (int mx = 0; mx < qr->width; ++mx)
         {
-            if (qr->data[y * qr->width + x] & 1)
+            const uint8_t *color = qr->module(mx, my) ? fg : bg;
+            for (int dx = 0; dx < size; ++dx)
             {
-                // 计算放大后的像素位置
-                const int px = (x + margin) * size;
-                const int py = (y + margin) * size;
-
-                // 填充放大区域
-                for (int dy = 0; dy < size; ++dy)
-                {
-                    for (int dx = 0; dx < size; ++dx)
-                    {
-                        const int pos = ((py + dy) * img_width + (px + dx)) * 4;
-                        result.pixels[pos + 0] = (fg_color >> 24) & 0xFF; // R
-                        result.pixels[pos + 1] = (fg_color >> 16) & 0xFF; // G
-                        result.pixels[pos + 2] = (fg_color >> 8) & 0xFF;  // B
-                        result.pixels[pos + 3] = fg_color & 0xFF;         // A
-                    }
-                }
+                memcpy(row + (mx * size + dx) * 4, color, 4);
             }
         }
+        for (int dy = 1; dy < size; ++dy)
+        {
+            memcpy(row + dy * row_bytes, row, row_bytes);
+        }
     }
 
-    QRcode_free(qr);
     return result;
 }
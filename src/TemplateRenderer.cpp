@@ -0,0 +1,253 @@
+#include "TemplateRenderer.h"
+#include "Framebuffer.h"
+#include "ImageDecoder.h"
+#include "Tools.h"
+#include <json/json.h>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <cstdio>
+#include <logger.h>
+
+namespace
+{
+    // "RRGGBBAA" / "RRGGBB" -> RGBA
+    uint32_t parse_color(const Json::Value &value, uint32_t fallback)
+    {
+        if (!value.isString())
+            return fallback;
+
+        std::string hex = value.asString();
+        if (!hex.empty() && hex[0] == '#')
+            hex = hex.substr(1);
+
+        try
+        {
+            if (hex.size() == 6)
+                return (static_cast<uint32_t>(std::stoul(hex, nullptr, 16)) << 8) | 0xFF;
+            if (hex.size() == 8)
+                return static_cast<uint32_t>(std::stoul(hex, nullptr, 16));
+        }
+        catch (const std::exception &)
+        {
+        }
+        return fallback;
+    }
+
+    TextAlign parse_align(const std::string &align)
+    {
+        if (align == "center")
+            return TextAlign::Center;
+        if (align == "right")
+            return TextAlign::Right;
+        return TextAlign::Left;
+    }
+}
+
+TemplateRenderer::TemplateRenderer(TextRenderer &text_renderer) : m_text(text_renderer)
+{
+}
+
+void TemplateRenderer::load(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("Failed to open template file: " + path);
+    }
+
+    Json::Value root;
+    Json::CharReaderBuilder builder;
+    std::string errors;
+    if (!Json::parseFromStream(builder, file, &root, &errors))
+    {
+        throw std::runtime_error("Invalid template file: " + errors);
+    }
+
+    m_width = root["width"].asInt();
+    m_height = root["height"].asInt();
+    m_background = parse_color(root["background"], 0x00000000);
+    m_slots.clear();
+
+    const TextRenderConfig defaults;
+    for (const auto &item : root["slots"])
+    {
+        TemplateSlot slot;
+        slot.name = item["name"].asString();
+        const std::string type = item["type"].asString();
+        if (type == "number")
+            slot.type = TemplateSlot::Type::Number;
+        else if (type == "image")
+            slot.type = TemplateSlot::Type::Image;
+        else
+            slot.type = TemplateSlot::Type::Text;
+
+        slot.left = item["left"].asInt();
+        slot.top = item["top"].asInt();
+        slot.width = item["width"].asInt();
+        slot.height = item["height"].asInt();
+
+        slot.font.font_path = item.get("font", defaults.font_path).asString();
+        for (const auto &fallback : item["fallbackFonts"])
+        {
+            slot.font.fallback_fonts.push_back(fallback.asString());
+        }
+        slot.font.size = item.get("size", defaults.size).asInt();
+        slot.font.color = parse_color(item["color"], defaults.color);
+        slot.font.bg_color = parse_color(item["bg"], 0x00000000);
+        slot.font.sdf = item.get("sdf", false).asBool();
+
+        slot.box.width = slot.width;
+        slot.box.height = slot.height;
+        slot.box.wrap = item.get("wrap", false).asBool();
+        slot.box.auto_fit = item.get("fit", false).asBool();
+        slot.box.min_size = item.get("minSize", slot.box.min_size).asInt();
+        slot.box.line_spacing = item.get("lineSpacing", 0).asInt();
+        slot.box.align = parse_align(item.get("align", "left").asString());
+
+        slot.decimals = item.get("decimals", 2).asInt();
+        slot.decimal_point = item.get("decimalPoint", ".").asString();
+        slot.prefix = item.get("prefix", "").asString();
+        slot.suffix = item.get("suffix", "").asString();
+        slot.value = item.get("value", "").asString();
+
+        // 单行不缩放的数字槽位预先构建精灵条，价格变化时只需几次小块混合
+        if (slot.type == TemplateSlot::Type::Number && !slot.box.wrap && !slot.box.auto_fit)
+        {
+            try
+            {
+                m_text.init(slot.font);
+                slot.sprites = &m_text.sprite_set(slot.decimal_point + slot.prefix + slot.suffix);
+            }
+            catch (const std::exception &e)
+            {
+                LOGW("Template", "槽位 %s 精灵条构建失败:%s", slot.name.c_str(), e.what());
+            }
+        }
+
+        m_slots.push_back(std::move(slot));
+    }
+
+    m_path = path;
+    m_rendered = false;
+}
+
+void TemplateRenderer::set_values(const std::map<std::string, std::string> &fields)
+{
+    for (auto &slot : m_slots)
+    {
+        auto it = fields.find(slot.name);
+        if (it != fields.end())
+        {
+            slot.value = it->second;
+        }
+    }
+}
+
+void TemplateRenderer::render(uint8_t *fb_ptr, const fb_var_screeninfo &vinfo, int x, int y)
+{
+    m_x = x;
+    m_y = y;
+
+    // 模板背景
+    const uint32_t background = (m_background << 24) | (m_background >> 8);
+    Framebuffer::fill_rect(fb_ptr, vinfo, x, y, m_width, m_height, background);
+
+    // 先保存每个槽位下方的像素，再绘制内容
+    for (auto &slot : m_slots)
+    {
+        Framebuffer::save_region(fb_ptr, vinfo, x + slot.left, y + slot.top, slot.width, slot.height, slot.backing);
+    }
+    for (auto &slot : m_slots)
+    {
+        draw_slot(fb_ptr, vinfo, slot);
+    }
+    m_rendered = true;
+}
+
+int TemplateRenderer::update(uint8_t *fb_ptr, const fb_var_screeninfo &vinfo,
+                             const std::map<std::string, std::string> &fields)
+{
+    int redrawn = 0;
+    for (auto &slot : m_slots)
+    {
+        auto it = fields.find(slot.name);
+        if (it == fields.end() || it->second == slot.value)
+            continue;
+
+        slot.value = it->second;
+        if (!m_rendered)
+            continue;
+
+        Framebuffer::restore_region(fb_ptr, vinfo, m_x + slot.left, m_y + slot.top, slot.width, slot.height, slot.backing);
+        draw_slot(fb_ptr, vinfo, slot);
+        ++redrawn;
+    }
+    return redrawn;
+}
+
+void TemplateRenderer::draw_slot(uint8_t *fb_ptr, const fb_var_screeninfo &vinfo, TemplateSlot &slot)
+{
+    const int x = m_x + slot.left;
+    const int y = m_y + slot.top;
+
+    try
+    {
+        switch (slot.type)
+        {
+        case TemplateSlot::Type::Text:
+            m_text.init(slot.font);
+            m_text.draw_text_box(fb_ptr, vinfo, slot.value, x, y, slot.box);
+            break;
+        case TemplateSlot::Type::Number:
+        {
+            const std::string text = format_number(slot);
+            m_text.init(slot.font);
+            if (!slot.sprites || !m_text.draw_sprites(fb_ptr, vinfo, *slot.sprites, text, x, y, slot.box))
+            {
+                m_text.draw_text_box(fb_ptr, vinfo, text, x, y, slot.box);
+            }
+            break;
+        }
+        case TemplateSlot::Type::Image:
+        {
+            if (slot.value.empty())
+                break;
+            const std::string image_path = slot.value[0] == '/' ? slot.value : Tools::get_download_dir() + slot.value;
+            ImageData img = ImageDecoder::decode(image_path);
+            Framebuffer::draw_image_to_framebuffer(fb_ptr, vinfo, img, x, y);
+            break;
+        }
+        }
+    }
+    catch (const std::exception &e)
+    {
+        LOGE("Template", "槽位 %s 绘制失败:%s", slot.name.c_str(), e.what());
+    }
+}
+
+std::string TemplateRenderer::format_number(const TemplateSlot &slot) const
+{
+    std::string number = slot.value;
+    try
+    {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%.*f", slot.decimals, std::stod(slot.value));
+        number = buf;
+        size_t dot = number.find('.');
+        if (dot != std::string::npos && slot.decimal_point != ".")
+        {
+            number.replace(dot, 1, slot.decimal_point);
+        }
+    }
+    catch (const std::exception &)
+    {
+        // 非数字原样显示
+    }
+    return slot.prefix + number + slot.suffix;
+}
+
+const std::string &TemplateRenderer::path() const
+{
+    return m_path;
+}
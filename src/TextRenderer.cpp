@@ -1,10 +1,114 @@
 #include "TextRenderer.h"
 #include "stb_truetype.h"
+#include "Framebuffer.h"
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
 #include <vector>
 #include <cmath>
+#include <algorithm>
+#include <logger.h>
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+    // 排版缓存上限，超出后整体清空
+    constexpr size_t kMaxLayoutCache = 256;
+
+    /**
+     * 解码下一个 UTF-8 码点，非法序列返回 U+FFFD
+     */
+    uint32_t next_codepoint(const std::string &text, size_t &i)
+    {
+        const unsigned char c = text[i++];
+        if (c < 0x80)
+            return c;
+
+        int extra;
+        uint32_t cp;
+        if ((c & 0xE0) == 0xC0)
+        {
+            extra = 1;
+            cp = c & 0x1F;
+        }
+        else if ((c & 0xF0) == 0xE0)
+        {
+            extra = 2;
+            cp = c & 0x0F;
+        }
+        else if ((c & 0xF8) == 0xF0)
+        {
+            extra = 3;
+            cp = c & 0x07;
+        }
+        else
+        {
+            return 0xFFFD;
+        }
+
+        for (int k = 0; k < extra; ++k)
+        {
+            if (i >= text.size() || (static_cast<unsigned char>(text[i]) & 0xC0) != 0x80)
+                return 0xFFFD;
+            cp = (cp << 6) | (static_cast<unsigned char>(text[i++]) & 0x3F);
+        }
+        return cp;
+    }
+
+    // SDF 参数：参考字号、边缘留白、边缘值与距离缩放
+    constexpr int kSdfReferenceSize = 48;
+    constexpr int kSdfPadding = 6;
+    constexpr unsigned char kSdfOnEdge = 128;
+    constexpr float kSdfDistScale = 128.0f / kSdfPadding;
+
+    /**
+     * 距离值 -> 覆盖率：x = bias + d * gain，截断到 [0,1] 后做 smoothstep
+     */
+    void sdf_threshold_row(const float *dist, uint8_t *out, int count, float gain)
+    {
+        const float bias = 0.5f - kSdfOnEdge * gain;
+        int i = 0;
+#if defined(__ARM_NEON)
+        const float32x4_t vgain = vdupq_n_f32(gain);
+        const float32x4_t vbias = vdupq_n_f32(bias);
+        const float32x4_t zero = vdupq_n_f32(0.0f);
+        const float32x4_t one = vdupq_n_f32(1.0f);
+        const float32x4_t two = vdupq_n_f32(2.0f);
+        const float32x4_t three = vdupq_n_f32(3.0f);
+        const float32x4_t half = vdupq_n_f32(0.5f);
+        const float32x4_t v255 = vdupq_n_f32(255.0f);
+        for (; i + 8 <= count; i += 8)
+        {
+            uint16x4_t parts[2];
+            for (int k = 0; k < 2; ++k)
+            {
+                float32x4_t x = vmlaq_f32(vbias, vld1q_f32(dist + i + k * 4), vgain);
+                x = vminq_f32(vmaxq_f32(x, zero), one);
+                const float32x4_t s = vmulq_f32(vmulq_f32(x, x), vmlsq_f32(three, two, x));
+                parts[k] = vmovn_u32(vcvtq_u32_f32(vmlaq_f32(half, s, v255)));
+            }
+            vst1_u8(out + i, vmovn_u16(vcombine_u16(parts[0], parts[1])));
+        }
+#endif
+        for (; i < count; ++i)
+        {
+            float x = std::min(std::max(bias + dist[i] * gain, 0.0f), 1.0f);
+            out[i] = static_cast<uint8_t>(x * x * (3.0f - 2.0f * x) * 255.0f + 0.5f);
+        }
+    }
+
+    // 中日韩字符之间允许任意断行
+    bool is_cjk(uint32_t cp)
+    {
+        return (cp >= 0x2E80 && cp <= 0x9FFF) ||
+               (cp >= 0xAC00 && cp <= 0xD7AF) ||
+               (cp >= 0xF900 && cp <= 0xFAFF) ||
+               (cp >= 0xFF00 && cp <= 0xFFEF) ||
+               (cp >= 0x20000 && cp <= 0x2FFFF);
+    }
+}
 
 TextRenderer::TextRenderer()
 {
@@ -14,126 +118,622 @@ TextRenderer::~TextRenderer()
 {
 }
 
-void TextRenderer::init(const TextRenderConfig &config)
+int TextRenderer::load_face(const std::string &path)
 {
-    m_config = config;
+    for (size_t i = 0; i < m_faces.size(); ++i)
+    {
+        if (m_faces[i]->path == path)
+            return static_cast<int>(i);
+    }
 
     // 1. 读取字体文件
-    std::ifstream file(config.font_path, std::ios::binary | std::ios::ate);
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
     if (!file.is_open())
     {
-        throw std::runtime_error("Failed to open font file: " + config.font_path);
+        throw std::runtime_error("Failed to open font file: " + path);
     }
 
     std::streamsize size = file.tellg();
     file.seekg(0, std::ios::beg);
 
-    m_ttf_buffer.resize(size);
-    if (!file.read((char *)m_ttf_buffer.data(), size))
+    auto face = std::make_unique<FontFace>();
+    face->path = path;
+    face->buffer.resize(size);
+    if (!file.read((char *)face->buffer.data(), size))
     {
-        throw std::runtime_error("Failed to read font file: " + config.font_path);
+        throw std::runtime_error("Failed to read font file: " + path);
     }
 
     // 2. 初始化 stb_truetype
-    if (!stbtt_InitFont(&m_font, m_ttf_buffer.data(), 0))
+    if (!stbtt_InitFont(&face->info, face->buffer.data(), 0))
     {
-        throw std::runtime_error("Failed to initialize font: " + config.font_path);
+        throw std::runtime_error("Failed to initialize font: " + path);
+    }
+    stbtt_GetFontVMetrics(&face->info, &face->ascent, &face->descent, &face->line_gap);
+
+    m_faces.push_back(std::move(face));
+    return static_cast<int>(m_faces.size() - 1);
+}
+
+void TextRenderer::init(const TextRenderConfig &config)
+{
+    m_config = config;
+
+    // 字体链只在字体配置变化时重建
+    std::string chain_key = config.font_path;
+    for (const auto &fallback : config.fallback_fonts)
+    {
+        chain_key += '\n' + fallback;
+    }
+
+    if (chain_key != m_chain_key)
+    {
+        std::vector<int> chain;
+        chain.push_back(load_face(config.font_path));
+        for (const auto &fallback : config.fallback_fonts)
+        {
+            try
+            {
+                chain.push_back(load_face(fallback));
+            }
+            catch (const std::exception &e)
+            {
+                LOGW("TextRenderer", "备用字体加载失败 %s:%s", fallback.c_str(), e.what());
+            }
+        }
+        m_chain = std::move(chain);
+        m_chain_key = chain_key;
     }
 
     // 3. 设置字体参数
-    m_scale = stbtt_ScaleForPixelHeight(&m_font, config.size);
-    stbtt_GetFontVMetrics(&m_font, &m_ascent, &m_descent, &m_lineGap);
+    m_metrics = metrics_for_size(config.size);
+}
+
+TextRenderer::FontMetrics TextRenderer::metrics_for_size(int size) const
+{
+    const FontFace &face = *m_faces[m_chain.front()];
+    FontMetrics metrics;
+    metrics.scale = stbtt_ScaleForPixelHeight(&face.info, size);
+    metrics.ascent = roundf(face.ascent * metrics.scale);
+    metrics.descent = roundf(face.descent * metrics.scale);
+    metrics.line_gap = roundf(face.line_gap * metrics.scale);
+    return metrics;
+}
+
+int TextRenderer::find_glyph_index(int face, uint32_t codepoint)
+{
+    FontFace &f = *m_faces[face];
+    auto it = f.glyph_index.find(codepoint);
+    if (it != f.glyph_index.end())
+        return it->second;
 
-    m_ascent = roundf(m_ascent * m_scale);
-    m_descent = roundf(m_descent * m_scale);
-    m_lineGap = roundf(m_lineGap * m_scale);
+    int index = stbtt_FindGlyphIndex(&f.info, codepoint);
+    f.glyph_index.emplace(codepoint, index);
+    return index;
 }
 
-ImageData TextRenderer::render_text(const std::string &text)
+int TextRenderer::glyph_advance(int face, int index)
 {
-    if (text.empty())
+    FontFace &f = *m_faces[face];
+    auto it = f.advance.find(index);
+    if (it != f.advance.end())
+        return it->second;
+
+    int advance, leftBearing;
+    stbtt_GetGlyphHMetrics(&f.info, index, &advance, &leftBearing);
+    f.advance.emplace(index, advance);
+    return advance;
+}
+
+void TextRenderer::shape(const std::string &text, std::vector<ShapedChar> &chars)
+{
+    chars.clear();
+    chars.reserve(text.size());
+
+    size_t i = 0;
+    while (i < text.size())
+    {
+        ShapedChar sc;
+        sc.codepoint = next_codepoint(text, i);
+        sc.face = m_chain.front();
+        sc.index = 0;
+
+        // 按字体链查找第一个包含该字符的字体
+        for (int face : m_chain)
+        {
+            int index = find_glyph_index(face, sc.codepoint);
+            if (index != 0)
+            {
+                sc.face = face;
+                sc.index = index;
+                break;
+            }
+        }
+        chars.push_back(sc);
+    }
+}
+
+bool TextRenderer::layout_at_size(const std::vector<ShapedChar> &chars, int size, const TextBox &box, TextLayout &out)
+{
+    const FontMetrics metrics = metrics_for_size(size);
+
+    // 各字体在该字号下的缩放比例
+    std::unordered_map<int, float> scales;
+    for (int face : m_chain)
     {
-        return ImageData{{}, 0, 0, 4};
+        scales[face] = stbtt_ScaleForPixelHeight(&m_faces[face]->info, size);
     }
 
-    // 1. 初始化尺寸计算
-    int width = 0;
-    int max_ascender = 0;
-    int max_descender = 0;
+    // 字符 i 的步进(含与前一字符的字距)
+    auto advance_of = [&](size_t i, size_t line_start) -> float
+    {
+        const ShapedChar &c = chars[i];
+        const float scale = scales[c.face];
+        float adv = glyph_advance(c.face, c.index) * scale;
+        if (i > line_start && chars[i - 1].face == c.face)
+        {
+            adv += stbtt_GetGlyphKernAdvance(&m_faces[c.face]->info, chars[i - 1].index, c.index) * scale;
+        }
+        return adv;
+    };
 
-    // 第一次遍历：计算文本总尺寸
-    int pen_x = 0;
-    for (char c : text)
+    // 1. 断行
+    struct Line
     {
-        int advance, leftBearing;
-        stbtt_GetCodepointHMetrics(&m_font, c, &advance, &leftBearing);
-        int x0, y0, x1, y1;
-        stbtt_GetCodepointBitmapBox(&m_font, c, m_scale, m_scale, &x0, &y0, &x1, &y1);
+        size_t begin;
+        size_t end;
+    };
+    std::vector<Line> lines;
+    const bool wrap = box.wrap && box.width > 0;
 
-        width += roundf(advance * m_scale);
-        max_ascender = std::max(max_ascender, -y0);
-        max_descender = std::max(max_descender, y1);
+    size_t line_start = 0;
+    size_t i = 0;
+    float pen = 0;
+    size_t break_end = std::string::npos; // 可断行位置(行尾)
+    size_t break_next = 0;                // 断行后下一行起点
+    while (i < chars.size())
+    {
+        const uint32_t cp = chars[i].codepoint;
+        if (cp == '\n')
+        {
+            lines.push_back({line_start, i});
+            line_start = ++i;
+            pen = 0;
+            break_end = std::string::npos;
+            continue;
+        }
+
+        if (i > line_start && (cp == ' ' || is_cjk(cp) || is_cjk(chars[i - 1].codepoint)))
+        {
+            break_end = i;
+            break_next = (cp == ' ') ? i + 1 : i;
+        }
+
+        const float adv = advance_of(i, line_start);
+        if (wrap && i > line_start && cp != ' ' && pen + adv > box.width)
+        {
+            size_t end = i;
+            size_t next = i;
+            if (break_end != std::string::npos)
+            {
+                end = break_end;
+                next = break_next;
+            }
+            lines.push_back({line_start, end});
+            while (next < chars.size() && chars[next].codepoint == ' ')
+                ++next;
+
+            line_start = i = next;
+            pen = 0;
+            break_end = std::string::npos;
+            continue;
+        }
+
+        pen += adv;
+        ++i;
     }
+    lines.push_back({line_start, chars.size()});
+
+    // 2. 定位字形
+    out.glyphs.clear();
+    out.size = size;
+    out.line_height = metrics.ascent - metrics.descent + metrics.line_gap;
+    out.line_count = static_cast<int>(lines.size());
+    out.width = 0;
 
-    // 计算最终尺寸
-    const int height = max_ascender + max_descender;
-    if (width <= 0 || height <= 0)
+    const int line_advance = out.line_height + box.line_spacing;
+    std::vector<float> positions;
+    for (size_t n = 0; n < lines.size(); ++n)
     {
-        return ImageData{{}, 0, 0, 4};
+        const Line &line = lines[n];
+        size_t end = line.end;
+        while (end > line.begin && chars[end - 1].codepoint == ' ')
+            --end;
+
+        positions.clear();
+        float x = 0;
+        for (size_t k = line.begin; k < end; ++k)
+        {
+            const float adv = advance_of(k, line.begin);
+            // 字距作用于当前字符之前
+            const float kern = adv - glyph_advance(chars[k].face, chars[k].index) * scales[chars[k].face];
+            positions.push_back(x + kern);
+            x += adv;
+        }
+
+        const int line_width = static_cast<int>(ceilf(x));
+        out.width = std::max(out.width, line_width);
+
+        int offset = 0;
+        if (box.width > 0 && box.align == TextAlign::Center)
+            offset = (box.width - line_width) / 2;
+        else if (box.width > 0 && box.align == TextAlign::Right)
+            offset = box.width - line_width;
+
+        const int baseline = metrics.ascent + static_cast<int>(n) * line_advance;
+        for (size_t k = line.begin; k < end; ++k)
+        {
+            if (chars[k].codepoint == ' ')
+                continue;
+            out.glyphs.push_back({chars[k].face, chars[k].index,
+                                  offset + static_cast<int>(roundf(positions[k - line.begin])), baseline});
+        }
     }
+    out.height = out.line_count * out.line_height + (out.line_count - 1) * box.line_spacing;
 
-    // 2. 创建图像缓冲区
-    ImageData result;
-    result.width = width;
-    result.height = height;
-    result.channels = 4; // RGBA
-    result.pixels.resize(width * height * 4, 0);
+    return (box.width <= 0 || out.width <= box.width) &&
+           (box.height <= 0 || out.height <= box.height);
+}
 
-    // 第二次遍历：渲染每个字符
-    pen_x = 0;
-    for (char c : text)
+const TextLayout &TextRenderer::layout(const std::string &text, const TextBox &box)
+{
+    std::string key = m_chain_key;
+    key += '\x1f' + std::to_string(m_config.size) + ',' + std::to_string(box.width) + ',' +
+           std::to_string(box.height) + ',' + std::to_string(box.wrap) + ',' +
+           std::to_string(box.auto_fit) + ',' + std::to_string(box.min_size) + ',' +
+           std::to_string(box.line_spacing) + ',' + std::to_string(static_cast<int>(box.align)) + '\x1f';
+    key += text;
+
+    auto it = m_layout_cache.find(key);
+    if (it != m_layout_cache.end())
     {
-        int advance, leftBearing;
-        stbtt_GetCodepointHMetrics(&m_font, c, &advance, &leftBearing);
-        int x0, y0, x1, y1;
-        stbtt_GetCodepointBitmapBox(&m_font, c, m_scale, m_scale, &x0, &y0, &x1, &y1);
+        return it->second;
+    }
 
-        int char_width, char_height, x_off, y_off;
-        unsigned char *bitmap = stbtt_GetCodepointBitmap(&m_font, m_scale, m_scale, c, &char_width, &char_height, &x_off, &y_off);
+    if (m_layout_cache.size() >= kMaxLayoutCache)
+    {
+        m_layout_cache.clear();
+    }
 
-        // 计算基线位置
-        const int baseline = max_ascender;
-        const int y_start = baseline + y_off; // 注意这里的 y_off 是负数
-        const int x_start = pen_x;
+    std::vector<ShapedChar> chars;
+    shape(text, chars);
 
-        // 渲染到图像缓冲区
-        for (int y = 0; y < char_height; ++y)
+    TextLayout result;
+    const bool fits = layout_at_size(chars, m_config.size, box, result);
+    if (box.auto_fit && !fits && m_config.size > box.min_size)
+    {
+        // 二分查找能放下的最大字号
+        int low = box.min_size;
+        int high = m_config.size - 1;
+        int best = box.min_size;
+        while (low <= high)
         {
-            for (int x = 0; x < char_width; ++x)
+            const int mid = (low + high) / 2;
+            if (layout_at_size(chars, mid, box, result))
             {
-                const int img_x = x + x_start;
-                const int img_y = y + y_start;
-
-                if (img_x < 0 || img_x >= width || img_y < 0 || img_y >= height)
-                    continue;
-
-                const int pos = (img_y * width + img_x) * 4;
-                const uint8_t alpha = bitmap[y * char_width + x];
-
-                // 混合颜色（带抗锯齿）
-                if (alpha > 0)
-                {
-                    const float alpha_f = alpha / 255.0f;
-                    result.pixels[pos + 0] = static_cast<uint8_t>((m_config.color >> 16) & 0xFF) * alpha_f; // R
-                    result.pixels[pos + 1] = static_cast<uint8_t>((m_config.color >> 8) & 0xFF) * alpha_f;  // G
-                    result.pixels[pos + 2] = static_cast<uint8_t>((m_config.color >> 0) & 0xFF) * alpha_f;  // B
-                    result.pixels[pos + 3] = alpha;                                                         // A
-                }
+                best = mid;
+                low = mid + 1;
+            }
+            else
+            {
+                high = mid - 1;
             }
         }
+        layout_at_size(chars, best, box, result);
+    }
+
+    return m_layout_cache.emplace(std::move(key), std::move(result)).first->second;
+}
+
+const GlyphMask &TextRenderer::get_glyph(int face, int index, int size)
+{
+    const uint64_t key = (static_cast<uint64_t>(face) << 48) |
+                         (static_cast<uint64_t>(size & 0xFFFF) << 32) |
+                         static_cast<uint32_t>(index);
+    auto it = m_glyph_cache.find(key);
+    if (it != m_glyph_cache.end())
+    {
+        return it->second;
+    }
+
+    const stbtt_fontinfo &info = m_faces[face]->info;
+    const float scale = stbtt_ScaleForPixelHeight(&info, size);
+
+    GlyphMask glyph;
+    glyph.advance = roundf(glyph_advance(face, index) * scale);
+
+    int x0, y0, x1, y1;
+    stbtt_GetGlyphBitmapBox(&info, index, scale, scale, &x0, &y0, &x1, &y1);
+    glyph.width = x1 - x0;
+    glyph.height = y1 - y0;
+    glyph.x_off = x0;
+    glyph.y_off = y0;
+
+    // 直接光栅化到缓存缓冲区，避免 stb 额外分配
+    if (glyph.width > 0 && glyph.height > 0)
+    {
+        glyph.coverage.resize(glyph.width * glyph.height);
+        stbtt_MakeGlyphBitmap(&info, glyph.coverage.data(), glyph.width, glyph.height,
+                              glyph.width, scale, scale, index);
+    }
+
+    return m_glyph_cache.emplace(key, std::move(glyph)).first->second;
+}
+
+const TextRenderer::SdfGlyph &TextRenderer::get_sdf_glyph(int face, int index)
+{
+    const uint64_t key = (static_cast<uint64_t>(face) << 32) | static_cast<uint32_t>(index);
+    auto it = m_sdf_cache.find(key);
+    if (it != m_sdf_cache.end())
+    {
+        return it->second;
+    }
+
+    const stbtt_fontinfo &info = m_faces[face]->info;
+    const float scale = stbtt_ScaleForPixelHeight(&info, kSdfReferenceSize);
+
+    SdfGlyph glyph;
+    unsigned char *field = stbtt_GetGlyphSDF(&info, scale, index, kSdfPadding, kSdfOnEdge, kSdfDistScale,
+                                             &glyph.width, &glyph.height, &glyph.x_off, &glyph.y_off);
+    if (field)
+    {
+        glyph.field.assign(field, field + glyph.width * glyph.height);
+        stbtt_FreeSDF(field, nullptr);
+    }
+    else
+    {
+        glyph.width = glyph.height = 0;
+    }
+
+    return m_sdf_cache.emplace(key, std::move(glyph)).first->second;
+}
+
+const GlyphMask &TextRenderer::render_sdf_glyph(int face, int index, int size)
+{
+    const SdfGlyph &sdf = get_sdf_glyph(face, index);
+    GlyphMask &out = m_sdf_scratch;
+    out.coverage.clear();
+    out.width = out.height = 0;
+    if (sdf.field.empty())
+    {
+        return out;
+    }
+
+    // 参考字号 -> 目标字号的缩放比
+    const float t = static_cast<float>(size) / kSdfReferenceSize;
+    out.x_off = static_cast<int>(floorf(sdf.x_off * t));
+    out.y_off = static_cast<int>(floorf(sdf.y_off * t));
+    out.width = static_cast<int>(ceilf((sdf.x_off + sdf.width) * t)) - out.x_off;
+    out.height = static_cast<int>(ceilf((sdf.y_off + sdf.height) * t)) - out.y_off;
+    if (out.width <= 0 || out.height <= 0)
+    {
+        out.width = out.height = 0;
+        return out;
+    }
+    out.coverage.resize(out.width * out.height);
+
+    // 预计算每列的采样位置
+    m_sdf_row.resize(out.width);
+    m_sdf_cols.resize(out.width);
+    m_sdf_fracs.resize(out.width);
+    for (int ox = 0; ox < out.width; ++ox)
+    {
+        const float sx = (out.x_off + ox + 0.5f) / t - sdf.x_off - 0.5f;
+        const float fx = floorf(sx);
+        m_sdf_cols[ox] = static_cast<int>(fx);
+        m_sdf_fracs[ox] = sx - fx;
+    }
+
+    // 越界视为远离轮廓
+    auto sample = [&](int x, int y) -> float
+    {
+        if (x < 0 || y < 0 || x >= sdf.width || y >= sdf.height)
+            return 0.0f;
+        return sdf.field[y * sdf.width + x];
+    };
+
+    const float gain = t / kSdfDistScale;
+    for (int oy = 0; oy < out.height; ++oy)
+    {
+        const float sy = (out.y_off + oy + 0.5f) / t - sdf.y_off - 0.5f;
+        const int y0 = static_cast<int>(floorf(sy));
+        const float fy = sy - y0;
+
+        // 1. 双线性重采样距离场
+        for (int ox = 0; ox < out.width; ++ox)
+        {
+            const int x0 = m_sdf_cols[ox];
+            const float fx = m_sdf_fracs[ox];
+            const float top = sample(x0, y0) + (sample(x0 + 1, y0) - sample(x0, y0)) * fx;
+            const float bottom = sample(x0, y0 + 1) + (sample(x0 + 1, y0 + 1) - sample(x0, y0 + 1)) * fx;
+            m_sdf_row[ox] = top + (bottom - top) * fy;
+        }
+
+        // 2. 阈值/平滑过渡生成覆盖率
+        sdf_threshold_row(m_sdf_row.data(), out.coverage.data() + oy * out.width, out.width, gain);
+    }
+
+    return out;
+}
+
+const SpriteSet &TextRenderer::sprite_set(const std::string &charset)
+{
+    const std::string chars = "0123456789.,-" + charset;
+    std::string key = m_chain_key + '\x1f' + std::to_string(m_config.size) + ',' +
+                      std::to_string(m_config.color) + ',' + std::to_string(m_config.sdf) + '\x1f' + chars;
+
+    auto it = m_sprite_cache.find(key);
+    if (it != m_sprite_cache.end())
+    {
+        return it->second;
+    }
+
+    std::vector<ShapedChar> shaped;
+    shape(chars, shaped);
 
-        pen_x += roundf(advance * m_scale);
+    SpriteSet set;
+    set.color = m_config.color;
+    set.ascent = m_metrics.ascent;
+    set.line_height = line_height();
+
+    // 1. 计算精灵条尺寸
+    int top = 0;
+    int bottom = 0;
+    for (const auto &c : shaped)
+    {
+        if (set.sprites.count(c.codepoint))
+            continue;
+
+        const GlyphMask &glyph = m_config.sdf ? render_sdf_glyph(c.face, c.index, m_config.size)
+                                              : get_glyph(c.face, c.index, m_config.size);
+        SpriteSet::Sprite sprite;
+        sprite.x = set.strip_width;
+        sprite.width = glyph.width;
+        sprite.height = glyph.height;
+        sprite.x_off = glyph.x_off;
+        sprite.y_off = glyph.y_off;
+        sprite.advance = roundf(glyph_advance(c.face, c.index) * stbtt_ScaleForPixelHeight(&m_faces[c.face]->info, m_config.size));
+        set.strip_width += glyph.width;
+        top = std::min(top, glyph.y_off);
+        bottom = std::max(bottom, glyph.y_off + glyph.height);
+        set.sprites.emplace(c.codepoint, sprite);
+    }
+    set.baseline = -top;
+    set.strip_height = bottom - top;
+    set.strip.assign(set.strip_width * set.strip_height, 0);
+
+    // 2. 将字形覆盖率拷贝到精灵条
+    for (const auto &c : shaped)
+    {
+        const SpriteSet::Sprite &sprite = set.sprites[c.codepoint];
+        const GlyphMask &glyph = m_config.sdf ? render_sdf_glyph(c.face, c.index, m_config.size)
+                                              : get_glyph(c.face, c.index, m_config.size);
+        for (int row = 0; row < glyph.height; ++row)
+        {
+            std::copy_n(glyph.coverage.data() + row * glyph.width, glyph.width,
+                        set.strip.data() + (set.baseline + glyph.y_off + row) * set.strip_width + sprite.x);
+        }
+    }
+
+    return m_sprite_cache.emplace(std::move(key), std::move(set)).first->second;
+}
+
+bool TextRenderer::draw_sprites(uint8_t *fb_ptr, const fb_var_screeninfo &vinfo, const SpriteSet &set,
+                                const std::string &text, int x, int y, const TextBox &box)
+{
+    // 查找精灵并累计预计算的步进
+    std::vector<const SpriteSet::Sprite *> sprites;
+    sprites.reserve(text.size());
+    int width = 0;
+    size_t i = 0;
+    while (i < text.size())
+    {
+        auto it = set.sprites.find(next_codepoint(text, i));
+        if (it == set.sprites.end())
+            return false;
+        sprites.push_back(&it->second);
+        width += it->second.advance;
+    }
+
+    // 背景色
+    const uint32_t bg_color = (m_config.bg_color << 24) | (m_config.bg_color >> 8);
+    if (bg_color >> 24)
+    {
+        Framebuffer::fill_rect(fb_ptr, vinfo, x, y, box.width > 0 ? box.width : width,
+                               box.height > 0 ? box.height : set.line_height, bg_color);
+    }
+
+    int pen_x = x;
+    if (box.width > 0 && box.align == TextAlign::Center)
+        pen_x += (box.width - width) / 2;
+    else if (box.width > 0 && box.align == TextAlign::Right)
+        pen_x += box.width - width;
+
+    const uint32_t color = (set.color << 24) | (set.color >> 8);
+    const int baseline = y + set.ascent;
+    for (const auto *sprite : sprites)
+    {
+        if (sprite->width > 0 && sprite->height > 0)
+        {
+            Framebuffer::draw_mask_to_framebuffer(fb_ptr, vinfo,
+                                                  set.strip.data() + (set.baseline + sprite->y_off) * set.strip_width + sprite->x,
+                                                  sprite->width, sprite->height, set.strip_width,
+                                                  pen_x + sprite->x_off, baseline + sprite->y_off, color);
+        }
+        pen_x += sprite->advance;
+    }
+    return true;
+}
+
+int TextRenderer::measure_text(const std::string &text)
+{
+    return layout(text).width;
+}
+
+int TextRenderer::line_height() const
+{
+    return m_metrics.ascent - m_metrics.descent + m_metrics.line_gap;
+}
+
+int TextRenderer::ascent() const
+{
+    return m_metrics.ascent;
+}
+
+void TextRenderer::draw_layout(uint8_t *fb_ptr, const fb_var_screeninfo &vinfo,
+                               const TextLayout &layout, int x, int y)
+{
+    // RGBA -> ARGB
+    const uint32_t color = (m_config.color << 24) | (m_config.color >> 8);
+
+    // 逐字形将覆盖率掩码混合到屏幕
+    for (const auto &g : layout.glyphs)
+    {
+        const GlyphMask &glyph = m_config.sdf ? render_sdf_glyph(g.face, g.index, layout.size)
+                                              : get_glyph(g.face, g.index, layout.size);
+        if (!glyph.coverage.empty())
+        {
+            Framebuffer::draw_mask_to_framebuffer(fb_ptr, vinfo, glyph.coverage.data(),
+                                                  glyph.width, glyph.height, glyph.width,
+                                                  x + g.x + glyph.x_off, y + g.y + glyph.y_off, color);
+        }
+    }
+}
+
+void TextRenderer::draw_text(uint8_t *fb_ptr, const fb_var_screeninfo &vinfo,
+                             const std::string &text, int x, int y)
+{
+    draw_text_box(fb_ptr, vinfo, text, x, y, {});
+}
+
+void TextRenderer::draw_text_box(uint8_t *fb_ptr, const fb_var_screeninfo &vinfo,
+                                 const std::string &text, int x, int y, const TextBox &box)
+{
+    if (text.empty())
+    {
+        return;
+    }
+
+    const TextLayout &result = layout(text, box);
+
+    // 背景色
+    const uint32_t bg_color = (m_config.bg_color << 24) | (m_config.bg_color >> 8);
+    if (bg_color >> 24)
+    {
+        const int width = box.width > 0 ? box.width : result.width;
+        const int height = box.height > 0 ? box.height : result.height;
+        Framebuffer::fill_rect(fb_ptr, vinfo, x, y, width, height, bg_color);
     }
 
-    return result;
+    draw_layout(fb_ptr, vinfo, result, x, y);
 }
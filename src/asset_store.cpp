@@ -0,0 +1,643 @@
+#include "asset_store.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <vector>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "atomic_file.h"
+#include "file_digest.h"
+#include "bulk_verifier.h"
+#include <logger.h>
+
+namespace
+{
+    constexpr const char *kIndexName = "assets.json";
+    // 没有超额时的检查间隔
+    constexpr std::chrono::minutes kGcInterval(10);
+    // 每删除一个文件后让出的时间，避免集中的删除操作影响播放
+    constexpr std::chrono::milliseconds kEvictPause(50);
+    // 超过此时间未续传的下载临时文件在启动时清理
+    constexpr int64_t kStalePartSeconds = 7 * 24 * 3600;
+    // 后台校验：每隔一段时间检查一个超过校验周期的文件
+    constexpr std::chrono::minutes kScrubInterval(30);
+    constexpr int64_t kScrubPeriodSeconds = 7 * 24 * 3600;
+    // 校验读取的块大小及块间停顿，限制对播放的影响
+    constexpr size_t kScrubBlockSize = 1024 * 1024;
+    constexpr std::chrono::milliseconds kScrubPause(10);
+
+    // linux/ioprio.h 在部分工具链中缺失
+    constexpr int kIoprioWhoProcess = 1;
+    constexpr int kIoprioClassIdle = 3;
+    constexpr int kIoprioClassShift = 13;
+
+    int64_t now_seconds()
+    {
+        return std::chrono::duration_cast<std::chrono::seconds>(
+                   std::chrono::system_clock::now().time_since_epoch())
+            .count();
+    }
+
+    bool stat_file(const std::string &path, uint64_t &size, int64_t &mtime_ns, uint64_t &inode)
+    {
+        struct stat st;
+        if (::stat(path.c_str(), &st) != 0)
+            return false;
+        size = st.st_size;
+        mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+        inode = st.st_ino;
+        return true;
+    }
+
+    bool ends_with(const std::string &s, const std::string &suffix)
+    {
+        return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+}
+
+AssetStore::AssetStore(const std::string &dir)
+    : dir_(dir), index_path_(dir + kIndexName), total_(0), quota_(0), dirty_(false),
+      stop_(false), gc_requested_(true), verify_requested_(false), cancel_verify_(false)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(dir_, ec);
+    load();
+    scan();
+    set_quota(0);
+    gc_thread_ = std::thread(&AssetStore::gc_loop, this);
+    scrub_thread_ = std::thread(&AssetStore::scrub_loop, this);
+}
+
+AssetStore::~AssetStore()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cancel_verify_ = true;
+    cv_.notify_all();
+    if (gc_thread_.joinable())
+    {
+        gc_thread_.join();
+    }
+    if (scrub_thread_.joinable())
+    {
+        scrub_thread_.join();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (dirty_)
+    {
+        save_locked();
+    }
+}
+
+bool AssetStore::is_asset(const std::string &name) const
+{
+    // 索引、下载日志和临时文件不属于资源
+    return name != kIndexName && name != "pending.json" &&
+           !ends_with(name, ".journal") && !ends_with(name, ".tmp") && name.find(".part") == std::string::npos;
+}
+
+void AssetStore::load()
+{
+    std::ifstream file(index_path_, std::ios::binary);
+    if (!file)
+        return;
+
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    const std::string content = buffer.str();
+
+    Json::Value root;
+    Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    std::string errors;
+    if (!reader->parse(content.c_str(), content.c_str() + content.size(), &root, &errors) || !root.isObject())
+        return;
+
+    const Json::Value &assets = root["assets"];
+    for (const auto &name : assets.getMemberNames())
+    {
+        Asset asset;
+        asset.size = assets[name]["size"].asUInt64();
+        asset.last_used = assets[name]["lastUsed"].asInt64();
+        asset.md5 = assets[name]["md5"].asString();
+        asset.mtime_ns = assets[name]["mtime"].asInt64();
+        asset.inode = assets[name]["inode"].asUInt64();
+        asset.verified_at = assets[name]["verifiedAt"].asInt64();
+        assets_[name] = asset;
+    }
+    // 上次保存的引用在播放列表重新下发前继续有效
+    const Json::Value &refs = root["references"];
+    for (const auto &device : refs.getMemberNames())
+    {
+        for (const auto &name : refs[device])
+        {
+            references_[device].insert(name.asString());
+        }
+    }
+}
+
+void AssetStore::scan()
+{
+    // 与磁盘上的实际文件核对：补充索引中没有的文件，去掉已不存在的
+    std::map<std::string, Asset> found;
+    std::error_code ec;
+    for (const auto &entry : std::filesystem::directory_iterator(dir_, ec))
+    {
+        if (!entry.is_regular_file(ec))
+            continue;
+        const std::string name = entry.path().filename().string();
+        if (ends_with(name, ".part"))
+        {
+            struct stat st;
+            if (::stat(entry.path().c_str(), &st) == 0 && st.st_mtime < now_seconds() - kStalePartSeconds)
+            {
+                LOGI("AssetStore", "清理未完成的下载 %s", name.c_str());
+                std::filesystem::remove(entry.path(), ec);
+                std::filesystem::remove(entry.path().string() + ".journal", ec);
+            }
+            continue;
+        }
+        if (!is_asset(name))
+            continue;
+
+        Asset asset;
+        asset.size = entry.file_size(ec);
+        auto it = assets_.find(name);
+        if (it != assets_.end())
+        {
+            // 保留使用时间和校验信息，文件是否变化在使用时比对
+            asset = it->second;
+            asset.size = entry.file_size(ec);
+        }
+        else
+        {
+            struct stat st;
+            asset.last_used = ::stat(entry.path().c_str(), &st) == 0 ? st.st_mtime : now_seconds();
+        }
+        found[name] = asset;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    dirty_ = dirty_ || found.size() != assets_.size();
+    assets_.swap(found);
+    total_ = 0;
+    for (const auto &asset : assets_)
+    {
+        total_ += asset.second.size;
+    }
+    LOGI("AssetStore", "资源文件:%d 占用:%llu", (int)assets_.size(), (unsigned long long)total_);
+}
+
+void AssetStore::save_locked()
+{
+    Json::Value root;
+    Json::Value assets(Json::objectValue);
+    for (const auto &asset : assets_)
+    {
+        Json::Value item;
+        item["size"] = static_cast<Json::UInt64>(asset.second.size);
+        item["lastUsed"] = static_cast<Json::Int64>(asset.second.last_used);
+        if (!asset.second.md5.empty())
+        {
+            item["md5"] = asset.second.md5;
+            item["mtime"] = static_cast<Json::Int64>(asset.second.mtime_ns);
+            item["inode"] = static_cast<Json::UInt64>(asset.second.inode);
+            item["verifiedAt"] = static_cast<Json::Int64>(asset.second.verified_at);
+        }
+        assets[asset.first] = item;
+    }
+    root["assets"] = assets;
+
+    Json::Value refs(Json::objectValue);
+    for (const auto &device : references_)
+    {
+        Json::Value names(Json::arrayValue);
+        for (const auto &name : device.second)
+        {
+            names.append(name);
+        }
+        refs[device.first] = names;
+    }
+    root["references"] = refs;
+
+    Json::StreamWriterBuilder wbuilder;
+    wbuilder["indentation"] = "";
+    if (AtomicFile::write(index_path_, Json::writeString(wbuilder, root)))
+    {
+        dirty_ = false;
+    }
+}
+
+void AssetStore::touch(const std::string &name)
+{
+    std::error_code ec;
+    uint64_t size = std::filesystem::file_size(dir_ + name, ec);
+    if (ec)
+        return;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Asset &asset = assets_[name];
+    total_ = total_ - asset.size + size;
+    asset.size = size;
+    asset.last_used = now_seconds();
+    dirty_ = true;
+    if (quota_ > 0 && total_ > quota_)
+    {
+        gc_requested_ = true;
+        cv_.notify_all();
+    }
+}
+
+bool AssetStore::is_verified(const std::string &name, const std::string &md5)
+{
+    uint64_t size;
+    int64_t mtime_ns;
+    uint64_t inode;
+    if (!stat_file(dir_ + name, size, mtime_ns, inode))
+        return false;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = assets_.find(name);
+    if (it == assets_.end())
+        return false;
+    const Asset &asset = it->second;
+    return !asset.md5.empty() && asset.md5 == md5 &&
+           asset.size == size && asset.mtime_ns == mtime_ns && asset.inode == inode;
+}
+
+void AssetStore::mark_verified(const std::string &name, const std::string &md5)
+{
+    uint64_t size;
+    int64_t mtime_ns;
+    uint64_t inode;
+    if (!stat_file(dir_ + name, size, mtime_ns, inode))
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Asset &asset = assets_[name];
+        total_ = total_ - asset.size + size;
+        asset.size = size;
+        asset.md5 = md5;
+        asset.mtime_ns = mtime_ns;
+        asset.inode = inode;
+        asset.verified_at = now_seconds();
+        if (asset.last_used == 0)
+            asset.last_used = asset.verified_at;
+        dirty_ = true;
+        if (verified_hook_)
+            hook_pending_.insert(name);
+    }
+    cv_.notify_all();
+}
+
+std::vector<std::string> AssetStore::verified_names()
+{
+    std::vector<std::string> names;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto &entry : assets_)
+    {
+        if (!entry.second.md5.empty())
+            names.push_back(entry.first);
+    }
+    return names;
+}
+
+void AssetStore::set_verified_hook(VerifiedHook hook)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        verified_hook_ = std::move(hook);
+        for (const auto &entry : assets_)
+        {
+            if (!entry.second.md5.empty())
+                hook_pending_.insert(entry.first);
+        }
+    }
+    cv_.notify_all();
+}
+
+void AssetStore::set_references(const std::string &device_id, const std::set<std::string> &names)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (references_[device_id] == names)
+        return;
+    references_[device_id] = names;
+    dirty_ = true;
+    gc_requested_ = true;
+    cv_.notify_all();
+}
+
+void AssetStore::pin(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    pinned_[name]++;
+}
+
+void AssetStore::unpin(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = pinned_.find(name);
+    if (it != pinned_.end() && --it->second <= 0)
+    {
+        pinned_.erase(it);
+    }
+}
+
+void AssetStore::set_quota(uint64_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    quota_ = bytes;
+    if (quota_ == 0)
+    {
+        struct statvfs vfs;
+        if (::statvfs(dir_.c_str(), &vfs) == 0)
+        {
+            quota_ = static_cast<uint64_t>(vfs.f_blocks) * vfs.f_frsize / 10 * 7;
+        }
+    }
+    LOGI("AssetStore", "资源磁盘配额:%llu", (unsigned long long)quota_);
+    gc_requested_ = true;
+    cv_.notify_all();
+}
+
+uint64_t AssetStore::usage()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return total_;
+}
+
+bool AssetStore::is_protected_locked(const std::string &name) const
+{
+    if (pinned_.count(name))
+        return true;
+    for (const auto &device : references_)
+    {
+        if (device.second.count(name))
+            return true;
+    }
+    return false;
+}
+
+bool AssetStore::evict_one()
+{
+    std::string victim;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (quota_ == 0 || total_ <= quota_)
+            return false;
+
+        int64_t oldest = INT64_MAX;
+        for (const auto &asset : assets_)
+        {
+            if (asset.second.last_used < oldest && !is_protected_locked(asset.first))
+            {
+                oldest = asset.second.last_used;
+                victim = asset.first;
+            }
+        }
+        if (victim.empty())
+        {
+            LOGW("AssetStore", "超出磁盘配额，但所有文件都在使用中");
+            return false;
+        }
+        total_ -= assets_[victim].size;
+        assets_.erase(victim);
+        dirty_ = true;
+    }
+
+    LOGI("AssetStore", "清理最久未使用的文件 %s", victim.c_str());
+    std::error_code ec;
+    std::filesystem::remove(dir_ + victim, ec);
+    return true;
+}
+
+void AssetStore::gc_loop()
+{
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait_for(lock, kGcInterval, [this]
+                         { return stop_ || gc_requested_; });
+            if (stop_)
+                return;
+            gc_requested_ = false;
+        }
+
+        // 每次只删一个文件，删完让出一段时间
+        while (evict_one())
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (cv_.wait_for(lock, kEvictPause, [this]
+                             { return stop_; }))
+                return;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (dirty_)
+        {
+            save_locked();
+        }
+    }
+}
+
+bool AssetStore::scrub_one()
+{
+    // 选出最久未校验且超过校验周期的文件
+    std::string name;
+    Asset asset;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        int64_t oldest = now_seconds() - kScrubPeriodSeconds;
+        for (const auto &entry : assets_)
+        {
+            if (!entry.second.md5.empty() && entry.second.verified_at < oldest && !pinned_.count(entry.first))
+            {
+                oldest = entry.second.verified_at;
+                name = entry.first;
+                asset = entry.second;
+            }
+        }
+    }
+    if (name.empty())
+        return false;
+
+    // 文件已被修改则不是损坏，交给下次使用时重新校验
+    if (!is_verified(name, asset.md5))
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = assets_.find(name);
+        if (it != assets_.end())
+        {
+            it->second.md5.clear();
+            dirty_ = true;
+        }
+        return true;
+    }
+
+    std::ifstream file(dir_ + name, std::ios::binary);
+    if (!file)
+        return true;
+
+    Md5Digest md5;
+    std::vector<char> buf(kScrubBlockSize);
+    while (file.read(buf.data(), buf.size()) || file.gcount() > 0)
+    {
+        md5.update(buf.data(), file.gcount());
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (cv_.wait_for(lock, kScrubPause, [this]
+                         { return stop_; }))
+            return false;
+    }
+    const std::string actual = md5.final_hex();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = assets_.find(name);
+    if (it == assets_.end())
+        return true;
+    if (actual == asset.md5)
+    {
+        it->second.verified_at = now_seconds();
+    }
+    else
+    {
+        // 清除校验记录，下次使用时重新校验并重新下载；
+        // 同一存储上的其他文件也可能受损，安排一次全量校验
+        LOGW("AssetStore", "后台校验发现文件损坏 %s", name.c_str());
+        it->second.md5.clear();
+        verify_requested_ = true;
+    }
+    dirty_ = true;
+    return true;
+}
+
+void AssetStore::clear_verified(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = assets_.find(name);
+    if (it != assets_.end() && !it->second.md5.empty())
+    {
+        it->second.md5.clear();
+        dirty_ = true;
+    }
+}
+
+void AssetStore::verify_all(bool force)
+{
+    std::vector<BulkVerifier::Item> items;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto &entry : assets_)
+        {
+            // 文件名即 MD5，下载中的文件不校验
+            const std::string md5 = entry.first.substr(0, entry.first.find('.'));
+            if (md5.size() != 32 || pinned_.count(entry.first))
+                continue;
+            BulkVerifier::Item item;
+            item.path = dir_ + entry.first;
+            item.expected_md5 = md5;
+            item.size = entry.second.size;
+            items.push_back(item);
+        }
+    }
+    if (!force)
+    {
+        items.erase(std::remove_if(items.begin(), items.end(), [this](const BulkVerifier::Item &item)
+                                   { return is_verified(item.path.substr(dir_.size()), item.expected_md5); }),
+                    items.end());
+    }
+    if (items.empty())
+        return;
+
+    LOGI("AssetStore", "开始批量校验 文件:%d", (int)items.size());
+    // 留一个核给播放
+    BulkVerifier verifier(std::max(1, (int)std::thread::hardware_concurrency() - 1));
+    verifier.set_cancel_flag(&cancel_verify_);
+    verifier.run(items, [this](const BulkVerifier::Item &item, const std::string &md5)
+                 {
+                     const std::string name = item.path.substr(dir_.size());
+                     if (md5 == item.expected_md5)
+                     {
+                         mark_verified(name, md5);
+                     }
+                     else if (!md5.empty())
+                     {
+                         LOGW("AssetStore", "批量校验发现文件损坏 %s", name.c_str());
+                         clear_verified(name);
+                     } },
+                 [](const BulkVerifier::Progress &progress)
+                 {
+                     LOGI("AssetStore", "校验进度 %d/%d %lluMB/%lluMB",
+                          (int)progress.files_done, (int)progress.files_total,
+                          (unsigned long long)(progress.bytes_done / (1024 * 1024)),
+                          (unsigned long long)(progress.bytes_total / (1024 * 1024)));
+                 });
+}
+
+void AssetStore::run_verified_hook()
+{
+    std::set<std::string> names;
+    VerifiedHook hook;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        names.swap(hook_pending_);
+        hook = verified_hook_;
+    }
+    for (const auto &name : names)
+    {
+        if (cancel_verify_)
+            return;
+        {
+            // 排队期间被删除或发现损坏的文件跳过
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = assets_.find(name);
+            if (it == assets_.end() || it->second.md5.empty())
+                continue;
+        }
+        hook(name, cancel_verify_);
+    }
+}
+
+void AssetStore::scrub_loop()
+{
+    // 本线程使用空闲 I/O 优先级，只在磁盘空闲时读取（批量校验线程继承此优先级）
+    syscall(SYS_ioprio_set, kIoprioWhoProcess, 0, (kIoprioClassIdle << kIoprioClassShift) | 0);
+
+    // 升级后首次启动时索引中没有校验记录，一次性校验完
+    verify_all(false);
+
+    while (true)
+    {
+        bool full = false;
+        bool hook = false;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait_for(lock, kScrubInterval, [this]
+                         { return stop_ || verify_requested_ || !hook_pending_.empty(); });
+            if (stop_)
+                return;
+            full = verify_requested_;
+            verify_requested_ = false;
+            hook = !hook_pending_.empty();
+        }
+        if (hook)
+        {
+            run_verified_hook();
+        }
+        if (full)
+        {
+            verify_all(true);
+        }
+        else if (!hook)
+        {
+            scrub_one();
+        }
+    }
+}
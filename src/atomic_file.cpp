@@ -0,0 +1,66 @@
+#include "atomic_file.h"
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+bool AtomicFile::write(const std::string &path, const std::string &content)
+{
+    const std::string tmp_path = path + ".tmp";
+    int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return false;
+
+    bool ok = true;
+    size_t written = 0;
+    while (ok && written < content.size())
+    {
+        ssize_t n = ::write(fd, content.data() + written, content.size() - written);
+        if (n < 0 && errno == EINTR)
+            continue;
+        ok = n > 0;
+        if (ok)
+            written += n;
+    }
+    ok = ok && ::fsync(fd) == 0;
+    int err = errno;
+    ok = (::close(fd) == 0) && ok;
+    if (ok)
+    {
+        ok = rename_synced(tmp_path, path);
+        err = errno;
+    }
+    if (!ok)
+    {
+        ::unlink(tmp_path.c_str());
+        errno = err;
+    }
+    return ok;
+}
+
+bool AtomicFile::publish(const std::string &tmp_path, const std::string &path)
+{
+    int fd = ::open(tmp_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    bool ok = ::fsync(fd) == 0;
+    ::close(fd);
+    return ok && rename_synced(tmp_path, path);
+}
+
+bool AtomicFile::rename_synced(const std::string &tmp_path, const std::string &path)
+{
+    if (::rename(tmp_path.c_str(), path.c_str()) != 0)
+        return false;
+
+    const size_t slash = path.find_last_of('/');
+    const std::string dir = slash == std::string::npos ? "." : path.substr(0, slash + 1);
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0)
+    {
+        // 部分文件系统不支持同步目录，不视为失败
+        ::fsync(fd);
+        ::close(fd);
+    }
+    return true;
+}
@@ -0,0 +1,108 @@
+#include "bulk_verifier.h"
+#include "file_digest.h"
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <logger.h>
+
+namespace
+{
+    constexpr std::chrono::seconds kProgressInterval(1);
+}
+
+BulkVerifier::BulkVerifier(int threads) : threads_(threads), cancelled_(nullptr)
+{
+    if (threads_ <= 0)
+    {
+        threads_ = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+BulkVerifier::Progress BulkVerifier::run(std::vector<Item> items, const ResultHandler &on_result,
+                                         const ProgressHandler &on_progress)
+{
+    // 大文件先开始，避免最后只剩一个线程在算一个大文件
+    std::sort(items.begin(), items.end(), [](const Item &a, const Item &b)
+              { return a.size > b.size; });
+
+    Progress total;
+    total.files_total = items.size();
+    for (const auto &item : items)
+    {
+        total.bytes_total += item.size;
+    }
+
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> files_done{0};
+    std::atomic<uint64_t> bytes_done{0};
+    std::mutex progress_mutex;
+    const auto start = std::chrono::steady_clock::now();
+    auto last_report = start;
+
+    auto snapshot = [&]()
+    {
+        Progress p = total;
+        p.files_done = files_done;
+        p.bytes_done = bytes_done;
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        p.bytes_per_sec = elapsed > 0 ? p.bytes_done / elapsed : 0;
+        return p;
+    };
+
+    auto report = [&](bool force)
+    {
+        if (!on_progress)
+            return;
+        std::lock_guard<std::mutex> lock(progress_mutex);
+        auto now = std::chrono::steady_clock::now();
+        if (!force && now - last_report < kProgressInterval)
+            return;
+        last_report = now;
+        on_progress(snapshot());
+    };
+
+    auto worker = [&]()
+    {
+        while (!(cancelled_ && *cancelled_))
+        {
+            size_t index = next++;
+            if (index >= items.size())
+                break;
+
+            const Item &item = items[index];
+            std::string md5 = Md5Digest::file_md5(
+                item.path, [&](uint64_t len)
+                {
+                    bytes_done += len;
+                    report(false); },
+                cancelled_);
+            // 中途取消的文件没有结果，不能当作校验失败
+            if (cancelled_ && *cancelled_)
+                break;
+            files_done++;
+            if (on_result)
+                on_result(item, md5);
+        }
+    };
+
+    const int count = std::min<int>(threads_, items.size());
+    std::vector<std::thread> threads;
+    for (int i = 1; i < count; ++i)
+    {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto &t : threads)
+    {
+        t.join();
+    }
+
+    Progress result = snapshot();
+    report(true);
+    LOGI("BulkVerifier", "批量校验结束 文件:%d/%d 大小:%lluMB 速度:%.1fMB/s 线程数:%d",
+         (int)result.files_done, (int)result.files_total,
+         (unsigned long long)(result.bytes_done / (1024 * 1024)),
+         result.bytes_per_sec / (1024 * 1024), count);
+    return result;
+}
@@ -0,0 +1,172 @@
+#include "chunk_manifest.h"
+#include "file_digest.h"
+#include <array>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace
+{
+    constexpr uint32_t kMinChunk = 16 * 1024;
+    constexpr uint32_t kAvgChunk = 64 * 1024;
+    constexpr uint32_t kMaxChunk = 256 * 1024;
+    // 平均长度之前用更严格的掩码，之后放宽，块长度集中在平均值附近
+    constexpr int kAvgBits = 16;
+    constexpr uint64_t kMaskStrict = ~0ULL << (64 - (kAvgBits + 2));
+    constexpr uint64_t kMaskLoose = ~0ULL << (64 - (kAvgBits - 2));
+    constexpr size_t kReadBuffer = 4 * 1024 * 1024;
+
+    // gear 表由种子为 0 的 splitmix64 依次生成，服务器端须一致
+    const std::array<uint64_t, 256> &gear_table()
+    {
+        static const std::array<uint64_t, 256> table = []
+        {
+            std::array<uint64_t, 256> t;
+            uint64_t state = 0;
+            for (auto &v : t)
+            {
+                uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+                z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+                z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+                v = z ^ (z >> 31);
+            }
+            return t;
+        }();
+        return table;
+    }
+
+    // 从 data 开始的下一块长度，n 不足最大块长时说明已到文件末尾
+    size_t cut_point(const uint8_t *data, size_t n)
+    {
+        if (n <= kMinChunk)
+            return n;
+        const auto &gear = gear_table();
+        uint64_t fp = 0;
+        size_t i = kMinChunk;
+        const size_t normal = std::min<size_t>(kAvgChunk, n);
+        for (; i < normal; ++i)
+        {
+            fp = (fp << 1) + gear[data[i]];
+            if (!(fp & kMaskStrict))
+                return i + 1;
+        }
+        const size_t limit = std::min<size_t>(kMaxChunk, n);
+        for (; i < limit; ++i)
+        {
+            fp = (fp << 1) + gear[data[i]];
+            if (!(fp & kMaskLoose))
+                return i + 1;
+        }
+        return limit;
+    }
+}
+
+bool ChunkManifest::build(const std::string &path, ChunkManifest &manifest, const std::atomic<bool> *cancelled)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    manifest.size = static_cast<uint64_t>(st.st_size);
+    manifest.chunks.clear();
+
+    // 缓冲区中剩余不足一个最大块时补充读取，块不会跨越缓冲区边界
+    std::vector<uint8_t> buffer(kReadBuffer);
+    size_t begin = 0, end = 0;
+    uint64_t buffer_offset = 0;
+    Md5Digest digest;
+    bool ok = true;
+    while (ok)
+    {
+        if (cancelled && *cancelled)
+        {
+            ok = false;
+            break;
+        }
+        if (end - begin < kMaxChunk && buffer_offset + end < manifest.size)
+        {
+            memmove(buffer.data(), buffer.data() + begin, end - begin);
+            buffer_offset += begin;
+            end -= begin;
+            begin = 0;
+            ssize_t n = pread(fd, buffer.data() + end, buffer.size() - end, buffer_offset + end);
+            if (n <= 0)
+            {
+                ok = false;
+                break;
+            }
+            end += n;
+        }
+        if (begin == end)
+            break;
+
+        const size_t len = cut_point(buffer.data() + begin, end - begin);
+        Chunk chunk;
+        chunk.offset = buffer_offset + begin;
+        chunk.length = static_cast<uint32_t>(len);
+        digest.reset();
+        digest.update(buffer.data() + begin, len);
+        chunk.md5 = digest.final_hex();
+        manifest.chunks.push_back(std::move(chunk));
+        begin += len;
+    }
+    ::close(fd);
+    return ok && (manifest.chunks.empty() ? 0 : manifest.chunks.back().offset + manifest.chunks.back().length) == manifest.size;
+}
+
+bool ChunkManifest::parse(const Json::Value &root)
+{
+    if (!root.isObject() || root["algorithm"].asString() != "gear" ||
+        root["min"].asUInt() != kMinChunk || root["avg"].asUInt() != kAvgChunk || root["max"].asUInt() != kMaxChunk)
+        return false;
+    const Json::Value &items = root["chunks"];
+    if (!items.isArray())
+        return false;
+
+    size = root["size"].asUInt64();
+    chunks.clear();
+    chunks.reserve(items.size());
+    uint64_t offset = 0;
+    for (const auto &item : items)
+    {
+        if (!item.isArray() || item.size() != 2)
+            return false;
+        Chunk chunk;
+        chunk.offset = offset;
+        chunk.md5 = item[0].asString();
+        chunk.length = item[1].asUInt();
+        if (chunk.md5.size() != 32 || chunk.length == 0 || chunk.length > kMaxChunk)
+            return false;
+        offset += chunk.length;
+        chunks.push_back(std::move(chunk));
+    }
+    return offset == size;
+}
+
+Json::Value ChunkManifest::to_json() const
+{
+    Json::Value root;
+    root["algorithm"] = "gear";
+    root["min"] = kMinChunk;
+    root["avg"] = kAvgChunk;
+    root["max"] = kMaxChunk;
+    root["size"] = static_cast<Json::UInt64>(size);
+    Json::Value items(Json::arrayValue);
+    for (const auto &chunk : chunks)
+    {
+        Json::Value item(Json::arrayValue);
+        item.append(chunk.md5);
+        item.append(chunk.length);
+        items.append(item);
+    }
+    root["chunks"] = items;
+    return root;
+}
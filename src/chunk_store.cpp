@@ -0,0 +1,166 @@
+#include "chunk_store.h"
+#include "file_digest.h"
+#include "atomic_file.h"
+#include <unordered_map>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <logger.h>
+
+namespace
+{
+    bool file_mtime(const std::string &path, uint64_t &size, int64_t &mtime_ns)
+    {
+        struct stat st;
+        if (::stat(path.c_str(), &st) != 0)
+            return false;
+        size = static_cast<uint64_t>(st.st_size);
+        mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+        return true;
+    }
+}
+
+ChunkStore::ChunkStore(const std::string &dir, SourceCheck usable)
+    : dir_(dir), index_dir_(dir + "chunks/"), usable_(std::move(usable))
+{
+}
+
+ChunkStore::Ranges ChunkStore::seed(const ChunkManifest &manifest, int fd, const std::string &extension,
+                                    const std::string &exclude, const std::atomic<bool> &cancelled)
+{
+    std::error_code ec;
+    prune();
+
+    // 块 MD5 -> 目标文件中的块序号（同一内容可能出现多次）
+    std::unordered_map<std::string, std::vector<size_t>> needed;
+    for (size_t i = 0; i < manifest.chunks.size(); ++i)
+    {
+        needed[manifest.chunks[i].md5].push_back(i);
+    }
+    std::vector<bool> filled(manifest.chunks.size(), false);
+
+    std::vector<char> buffer;
+    Md5Digest digest;
+    for (const auto &entry : std::filesystem::directory_iterator(dir_, ec))
+    {
+        if (needed.empty() || cancelled)
+            break;
+        const std::string name = entry.path().filename().string();
+        if (!entry.is_regular_file(ec) || entry.path().extension() != extension || name == exclude || !usable_(name))
+            continue;
+
+        ChunkManifest local;
+        if (!cached(name, local))
+            continue;
+        int source = ::open((dir_ + name).c_str(), O_RDONLY | O_CLOEXEC);
+        if (source == -1)
+            continue;
+        for (const auto &chunk : local.chunks)
+        {
+            auto it = needed.find(chunk.md5);
+            if (it == needed.end())
+                continue;
+
+            // 读回的数据再核对一次，缓存的清单与文件不一致时不使用
+            buffer.resize(chunk.length);
+            digest.reset();
+            if (pread(source, buffer.data(), chunk.length, chunk.offset) != static_cast<ssize_t>(chunk.length) ||
+                !digest.update(buffer.data(), chunk.length) || digest.final_hex() != chunk.md5)
+            {
+                LOGW("ChunkStore", "分块清单与文件不一致 %s", name.c_str());
+                std::filesystem::remove(index_dir_ + name + ".json", ec);
+                break;
+            }
+            for (size_t index : it->second)
+            {
+                const auto &target = manifest.chunks[index];
+                if (target.length == chunk.length &&
+                    pwrite(fd, buffer.data(), chunk.length, target.offset) == static_cast<ssize_t>(chunk.length))
+                {
+                    filled[index] = true;
+                }
+            }
+            needed.erase(it);
+        }
+        ::close(source);
+    }
+
+    Ranges ranges;
+    uint64_t reused = 0;
+    for (size_t i = 0; i < manifest.chunks.size(); ++i)
+    {
+        if (!filled[i])
+            continue;
+        const auto &chunk = manifest.chunks[i];
+        reused += chunk.length;
+        if (!ranges.empty() && ranges.back().second == chunk.offset)
+            ranges.back().second += chunk.length;
+        else
+            ranges.emplace_back(chunk.offset, chunk.offset + chunk.length);
+    }
+    LOGI("ChunkStore", "复用本地块 %llu/%llu 字节", (unsigned long long)reused, (unsigned long long)manifest.size);
+    return ranges;
+}
+
+void ChunkStore::refresh(const std::string &name, const std::atomic<bool> &cancelled)
+{
+    ChunkManifest manifest;
+    if (cached(name, manifest))
+        return;
+
+    // 第一次作为块来源或文件已变化，重新分块
+    uint64_t size;
+    int64_t mtime_ns;
+    if (!file_mtime(dir_ + name, size, mtime_ns) ||
+        !ChunkManifest::build(dir_ + name, manifest, &cancelled) || manifest.size != size)
+        return;
+    LOGI("ChunkStore", "生成分块清单 %s 块数:%zu", name.c_str(), manifest.chunks.size());
+
+    std::error_code ec;
+    std::filesystem::create_directories(index_dir_, ec);
+    Json::Value root = manifest.to_json();
+    root["mtime"] = static_cast<Json::Int64>(mtime_ns);
+    Json::StreamWriterBuilder wbuilder;
+    wbuilder["indentation"] = "";
+    AtomicFile::write(index_dir_ + name + ".json", Json::writeString(wbuilder, root));
+}
+
+bool ChunkStore::cached(const std::string &name, ChunkManifest &manifest)
+{
+    uint64_t size;
+    int64_t mtime_ns;
+    if (!file_mtime(dir_ + name, size, mtime_ns))
+        return false;
+
+    std::ifstream file(index_dir_ + name + ".json", std::ios::binary);
+    if (!file)
+        return false;
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    const std::string content = buffer.str();
+
+    Json::Value root;
+    Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    std::string errors;
+    return reader->parse(content.c_str(), content.c_str() + content.size(), &root, &errors) &&
+           root.isObject() && root["mtime"].asInt64() == mtime_ns && manifest.parse(root) && manifest.size == size;
+}
+
+void ChunkStore::prune()
+{
+    // 资源文件已删除的清单一并删除
+    std::error_code ec;
+    for (const auto &entry : std::filesystem::directory_iterator(index_dir_, ec))
+    {
+        const std::string name = entry.path().stem().string();
+        if (entry.path().extension() == ".json" && !std::filesystem::exists(dir_ + name, ec))
+        {
+            std::filesystem::remove(entry.path(), ec);
+        }
+    }
+}
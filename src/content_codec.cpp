@@ -0,0 +1,77 @@
+#include "content_codec.h"
+#ifdef CPPHTTPLIB_ZLIB_SUPPORT
+#include <zlib.h>
+#endif
+#ifdef CPPHTTPLIB_BROTLI_SUPPORT
+#include <brotli/decode.h>
+#endif
+
+namespace
+{
+    constexpr size_t kChunkSize = 64 * 1024;
+
+#ifdef CPPHTTPLIB_ZLIB_SUPPORT
+    bool inflate_data(const std::string &data, std::string &out, size_t max_size)
+    {
+        z_stream stream{};
+        // 32：自动识别 gzip 或 zlib 头
+        if (inflateInit2(&stream, 15 + 32) != Z_OK)
+            return false;
+
+        stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+        stream.avail_in = static_cast<uInt>(data.size());
+        char buf[kChunkSize];
+        int ret = Z_OK;
+        while (ret != Z_STREAM_END)
+        {
+            stream.next_out = reinterpret_cast<Bytef *>(buf);
+            stream.avail_out = sizeof(buf);
+            ret = inflate(&stream, Z_NO_FLUSH);
+            if (ret != Z_OK && ret != Z_STREAM_END)
+                break;
+            out.append(buf, sizeof(buf) - stream.avail_out);
+            if (out.size() > max_size || (ret == Z_OK && stream.avail_in == 0 && stream.avail_out != 0))
+                break;
+        }
+        inflateEnd(&stream);
+        return ret == Z_STREAM_END && out.size() <= max_size;
+    }
+#endif
+
+#ifdef CPPHTTPLIB_BROTLI_SUPPORT
+    bool brotli_decode(const std::string &data, std::string &out, size_t max_size)
+    {
+        BrotliDecoderState *state = BrotliDecoderCreateInstance(nullptr, nullptr, nullptr);
+        if (!state)
+            return false;
+
+        const uint8_t *next_in = reinterpret_cast<const uint8_t *>(data.data());
+        size_t avail_in = data.size();
+        uint8_t buf[kChunkSize];
+        BrotliDecoderResult result = BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT;
+        while (result == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT && out.size() <= max_size)
+        {
+            uint8_t *next_out = buf;
+            size_t avail_out = sizeof(buf);
+            result = BrotliDecoderDecompressStream(state, &avail_in, &next_in, &avail_out, &next_out, nullptr);
+            out.append(reinterpret_cast<char *>(buf), sizeof(buf) - avail_out);
+        }
+        BrotliDecoderDestroyInstance(state);
+        return result == BROTLI_DECODER_RESULT_SUCCESS && out.size() <= max_size;
+    }
+#endif
+}
+
+bool ContentCodec::decompress(const std::string &encoding, const std::string &data, std::string &out, size_t max_size)
+{
+    out.clear();
+#ifdef CPPHTTPLIB_ZLIB_SUPPORT
+    if (encoding == "gzip" || encoding == "deflate")
+        return inflate_data(data, out, max_size);
+#endif
+#ifdef CPPHTTPLIB_BROTLI_SUPPORT
+    if (encoding == "br")
+        return brotli_decode(data, out, max_size);
+#endif
+    return false;
+}
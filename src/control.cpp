@@ -27,6 +27,9 @@ Control::Control(const std::string &url_root, const std::string &client_id)
     {
         display_ = std::make_shared<Display>(client_id, "/dev/fb1"); // 初始化显示器
     }
+    // 同一局域网内的播放器之间互相共享已下载的文件
+    downloader_.enable_peer_sharing();
+    downloader_.enable_multicast_push();
     downloader_.setDownloadCallback([this](const MediaItem &media, const std::string &local_path, bool success, const std::string &error)
                                     { this->downloadCallback(media, local_path, success, error); });
 }
@@ -76,6 +79,9 @@ void Control::start()
     // 设置回调函数
     mqtt_client_->setMessageCallback([this](const std::string &code, const std::string &body)
                                      { this->handleMessage(code, body); });
+    // 心跳等消息的确认时延反映上行拥塞，用于下载退避
+    mqtt_client_->setRttCallback([this](int rtt_ms)
+                                 { downloader_.report_network_rtt(rtt_ms); });
 
     // 确保连接成功
     if (!mqtt_client_->isConnected())
@@ -110,6 +116,18 @@ void Control::handleMessage(const std::string &code, const std::string &body)
             return;
         this->refresh(device_id);
     }
+    else if ("0009" == code)
+    {
+        // 价签模板字段更新 {"device":"...","fields":{"price":"12.99"}}
+        std::map<std::string, std::string> fields;
+        std::string device_id = task_repository_.saveFields(body, fields);
+        if (device_id.empty())
+            return;
+        if (display_->getDeviceId() == device_id)
+        {
+            display_->updateTemplateFields(fields);
+        }
+    }
     else if ("0005" == code)
     {
         // 设置屏幕亮度
@@ -145,6 +163,11 @@ void Control::handleMessage(const std::string &code, const std::string &body)
                     int64_t openTime = tokens[3].empty() ? 0 : std::stoll(tokens[3]);  // 系统开机时间戳
                     int64_t closeTime = tokens[4].empty() ? 0 : std::stoll(tokens[4]); // 系统关机时间戳
                 }
+                if (tokens.size() >= 6 && !tokens[5].empty())
+                {
+                    // 下载目录磁盘配额（MB），0 为分区容量的 70%
+                    downloader_.set_disk_quota(static_cast<uint64_t>(std::stoll(tokens[5])) * 1024 * 1024);
+                }
 
                 heartbeat(speed);
             }
@@ -158,6 +181,66 @@ void Control::handleMessage(const std::string &code, const std::string &body)
             LOGE("Control", "配置参数格式无效 ");
         }
     }
+    else if ("0010" == code)
+    {
+        // 下载限速（KB/s，0 不限速） 总速率&单个传输&时段  512&256&08:00-22:00=256;22:00-08:00=0
+        std::vector<std::string> tokens;
+        std::string token;
+        std::istringstream tokenStream(body);
+        while (std::getline(tokenStream, token, '&'))
+        {
+            tokens.push_back(token);
+        }
+        try
+        {
+            RateLimiter::Config config;
+            if (tokens.size() >= 1 && !tokens[0].empty())
+                config.global_rate = static_cast<uint64_t>(std::stoll(tokens[0])) * 1024;
+            if (tokens.size() >= 2 && !tokens[1].empty())
+                config.transfer_rate = static_cast<uint64_t>(std::stoll(tokens[1])) * 1024;
+            if (tokens.size() >= 3 && !RateLimiter::parse_schedule(tokens[2], config.schedule))
+            {
+                LOGE("Control", "限速时段格式无效:%s ", tokens[2].c_str());
+                return;
+            }
+            downloader_.set_rate_limit(config);
+        }
+        catch (const std::exception &e)
+        {
+            LOGE("Control", "限速参数解析错误:%s ", e.what());
+        }
+    }
+    else if ("0011" == code)
+    {
+        // 由本播放器把已下载的文件组播推送给同一网段的播放器  文件名&速率(KB/s，可省略)
+        size_t pos = body.find('&');
+        const std::string name = body.substr(0, pos);
+        uint64_t rate = 0;
+        try
+        {
+            if (pos != std::string::npos)
+                rate = static_cast<uint64_t>(std::stoll(body.substr(pos + 1))) * 1024;
+        }
+        catch (const std::exception &e)
+        {
+            LOGE("Control", "推送速率格式无效:%s ", e.what());
+            return;
+        }
+        downloader_.push_asset(name, rate);
+    }
+    else if ("0012" == code)
+    {
+        // 备用源站，逗号分隔，为空时只用主地址  http://cdn.example.com/,http://192.168.1.10:4011/
+        std::vector<std::string> roots;
+        std::string root;
+        std::istringstream tokenStream(body);
+        while (std::getline(tokenStream, root, ','))
+        {
+            if (!root.empty())
+                roots.push_back(root);
+        }
+        downloader_.set_mirrors(roots);
+    }
 }
 
 /// @brief 刷新播放器
@@ -166,14 +249,18 @@ void Control::refresh(const std::string device_id)
 {
     LOGI("Control", "刷新设备播放列表:%s ", device_id.c_str());
     auto playList = task_repository_.getPlayList(device_id);
+    std::vector<MediaItem> items;
     for (const auto &item : playList)
     {
-        downloader_.add_task(*item);
+        items.push_back(*item);
     }
+    // 先清空旧的画面再调度：已缓存的文件会在工作线程上立即完成并加入显示
     if (display_->getDeviceId() == device_id)
     {
         display_->clear();
     }
+    // 新播放列表替换旧的，不在屏幕上的设备只做预取，不占用当前画面的下载
+    downloader_.schedule(device_id, items, display_->getDeviceId() != device_id);
 }
 
 /// @brief 文件下载完成回调
@@ -185,6 +272,11 @@ void Control::downloadCallback(const MediaItem &media, const std::string &local_
     {
         if (display_->getDeviceId() == media.device_id)
         {
+            if (media.type == 2)
+            {
+                // 先恢复已保存的字段，模板首次绘制即为最新价格
+                display_->updateTemplateFields(task_repository_.getFields(media.device_id));
+            }
             display_->addMediaItem(media, local_path);
         }
     }
@@ -14,7 +14,7 @@
 #include <QrCodeGenerator.h>
 #include <logger.h>
 
-Display::Display(const std::string &client_id, const char *fb_device) : device_id_(client_id), fb_device_(fb_device), m_text_renderer(std::make_unique<TextRenderer>())
+Display::Display(const std::string &client_id, const char *fb_device) : device_id_(client_id), fb_device_(fb_device), m_text_renderer(std::make_unique<TextRenderer>()), template_text_(std::make_unique<TextRenderer>())
 {
 
     init_framebuffer();
@@ -104,25 +104,24 @@ void Display::show_info()
             data += ";" + ip;
         }
 
-        // 生成RGBA格式的二维码
-        ImageData qr_img = QrCodeGenerator::generate(
-            data,
-            8,
-            4,
-            0x000000FF, // 黑色前景
-            0xFFFFFF00  // 白色背景（透明）
-        );
+        // 二维码按模块矩阵缓存，直接绘制到屏幕
+        auto qr = QrCodeGenerator::encode(data, 4);
+        const int qr_size = qr->width * 8;
         // 计算居中位置
-        int x = (fb_info_.vinfo.xres - qr_img.width) / 2;
-        int y = (fb_info_.vinfo.yres - qr_img.height) / 2;
+        int x = (fb_info_.vinfo.xres - qr_size) / 2;
+        int y = (fb_info_.vinfo.yres - qr_size) / 2;
 
-        display_image_data(qr_img, x, y);
+        ensure_framebuffer_mapped();
+        QrCodeGenerator::draw(fb_info_.mapped, fb_info_.vinfo, *qr, x, y, 8,
+                              0x000000FF, // 黑色前景
+                              0xFFFFFF00  // 白色背景（透明）
+        );
 
         std::vector<std::string> info = {
             device_id_,
             ip};
         // 显示设备id
-        draw_text_multi(info, x + 50, y + qr_img.height + 10, 8);
+        draw_text_multi(info, x + 50, y + qr_size + 10, 8);
 
         draw_text(Tools::get_version(), x + 60, fb_info_.vinfo.yres - 50);
     }
@@ -144,8 +143,8 @@ void Display::show_config()
 
         int window_width = 800;                  // fb_info_.vinfo.xres
         int window_height = fb_info_.vinfo.yres; // 1280
-        ImageData result = Tools::create_image(0xFFFFFFFF, window_width - 140, window_height - 240);
-        display_image_data(result, 40, 100);
+        ensure_framebuffer_mapped();
+        Framebuffer::fill_rect(fb_info_.mapped, fb_info_.vinfo, 40, 100, window_width - 140, window_height - 240, 0xFFFFFFFF);
 
         // config wifi
         draw_text("Configure  WIFI", 140, 120, {.size = 40});
@@ -176,18 +175,17 @@ void Display::show_config()
             data += ";" + ip;
         }
 
-        // 生成RGBA格式的二维码
-        ImageData qr_img = QrCodeGenerator::generate(
-            data,
-            8,
-            4,
-            0x000000FF, // 黑色前景
-            0xFFFFFF00  // 白色背景（透明）
-        );
+        // 二维码按模块矩阵缓存，直接绘制到屏幕
+        auto qr = QrCodeGenerator::encode(data, 4);
+        const int qr_size = qr->width * 8;
         // 计算居中位置
-        int x = (window_width - qr_img.width) / 2;
-        display_image_data(qr_img, x - 40, 360);
-        int y = 380 + qr_img.height;
+        int x = (window_width - qr_size) / 2;
+        ensure_framebuffer_mapped();
+        QrCodeGenerator::draw(fb_info_.mapped, fb_info_.vinfo, *qr, x - 40, 360, 8,
+                              0x000000FF, // 黑色前景
+                              0xFFFFFF00  // 白色背景（透明）
+        );
+        int y = 380 + qr_size;
         // 显示设备id
         draw_text(device_id_, 210, y, {.size = 40});
         if (!ip.empty())
@@ -217,6 +215,10 @@ void Display::addMediaItem(const MediaItem &media, const std::string &local_path
             updatePrice(media, local_path);
         }
     }
+    else if (media.type == 2)
+    {
+        updateTemplate(media, local_path);
+    }
     else
     {
 
@@ -252,6 +254,21 @@ void Display::updateBackground(const MediaItem &media, const std::string &local_
             break;
         }
     }
+
+    // 背景变化后重新绘制模板
+    std::lock_guard<std::mutex> lock(template_mutex_);
+    if (template_)
+    {
+        try
+        {
+            ensure_framebuffer_mapped();
+            template_->render(fb_info_.mapped, fb_info_.vinfo, template_media_.left, template_media_.top);
+        }
+        catch (const std::exception &e)
+        {
+            LOGE("Display", "模板绘制错误 :%s ", e.what());
+        }
+    }
 }
 
 void Display::updatePrice(const MediaItem &media, const std::string &local_path)
@@ -260,6 +277,49 @@ void Display::updatePrice(const MediaItem &media, const std::string &local_path)
     display_image(local_path.c_str(), media.left, media.top);
 }
 
+void Display::updateTemplate(const MediaItem &media, const std::string &local_path)
+{
+    std::lock_guard<std::mutex> lock(template_mutex_);
+    try
+    {
+        auto renderer = std::make_unique<TemplateRenderer>(*template_text_);
+        renderer->load(local_path);
+        renderer->set_values(template_fields_);
+
+        ensure_framebuffer_mapped();
+        renderer->render(fb_info_.mapped, fb_info_.vinfo, media.left, media.top);
+        template_ = std::move(renderer);
+        template_media_ = media;
+    }
+    catch (const std::exception &e)
+    {
+        LOGE("Display", "模板加载错误 :%s ", e.what());
+    }
+}
+
+void Display::updateTemplateFields(const std::map<std::string, std::string> &fields)
+{
+    std::lock_guard<std::mutex> lock(template_mutex_);
+    for (const auto &field : fields)
+    {
+        template_fields_[field.first] = field.second;
+    }
+
+    if (!template_)
+        return;
+
+    try
+    {
+        ensure_framebuffer_mapped();
+        int redrawn = template_->update(fb_info_.mapped, fb_info_.vinfo, fields);
+        LOGI("Display", "模板字段更新，重绘槽位:%d", redrawn);
+    }
+    catch (const std::exception &e)
+    {
+        LOGE("Display", "模板更新错误 :%s ", e.what());
+    }
+}
+
 void Display::display_image(const std::string &image_path, const int offset_x, const int offset_y)
 {
     try
@@ -309,8 +369,8 @@ void Display::clear_screen(uint32_t color)
 {
     try
     {
-        ImageData result = Tools::create_image(color, fb_info_.vinfo.xres, fb_info_.vinfo.yres);
-        display_image_data(result, 0, 0);
+        ensure_framebuffer_mapped();
+        Framebuffer::fill_rect(fb_info_.mapped, fb_info_.vinfo, 0, 0, fb_info_.vinfo.xres, fb_info_.vinfo.yres, color | 0xFF000000);
     }
     catch (const std::exception &e)
     {
@@ -323,9 +383,9 @@ void Display::draw_text(const std::string &text, int x, int y,
 {
     try
     {
+        ensure_framebuffer_mapped();
         m_text_renderer->init(config);
-        ImageData text_img = m_text_renderer->render_text(text);
-        display_image_data(text_img, x, y);
+        m_text_renderer->draw_text(fb_info_.mapped, fb_info_.vinfo, text, x, y);
     }
     catch (const std::exception &e)
     {
@@ -336,16 +396,21 @@ void Display::draw_text(const std::string &text, int x, int y,
 void Display::draw_text_multi(const std::vector<std::string> &lines, int x, int y, int line_spacing,
                               const TextRenderConfig &config)
 {
-    m_text_renderer->init(config);
-
-    // 获取行高
-    ImageData sample = m_text_renderer->render_text("A");
-    int line_height = sample.height + line_spacing; // 加5像素行间距
+    try
+    {
+        // 行高取自缓存的字体度量
+        m_text_renderer->init(config);
+        int line_height = m_text_renderer->line_height() + line_spacing;
 
-    for (const auto &line : lines)
+        for (const auto &line : lines)
+        {
+            draw_text(line, x, y, config);
+            y += line_height;
+        }
+    }
+    catch (const std::exception &e)
     {
-        draw_text(line, x, y, config);
-        y += line_height;
+        LOGE("Display", "Text render error :%s ", e.what());
     }
 }
 
@@ -354,6 +419,9 @@ void Display::clear()
     // player_.clear_list();
     media_items_.clear();
 
+    std::lock_guard<std::mutex> lock(template_mutex_);
+    template_.reset();
+
     // if (player_.getState() == GstPlayer::State::PLAYING)
     //     player_.stop();
 }
@@ -0,0 +1,194 @@
+#include "download_journal.h"
+#include "atomic_file.h"
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <logger.h>
+
+namespace
+{
+    Json::Value task_to_json(const MediaItem &task)
+    {
+        Json::Value item;
+        item["Id"] = task.id;
+        item["ConfirmURL"] = task.confirm_url;
+        item["DownloadURL"] = task.download_url;
+        item["FileName"] = task.file_name;
+        item["Group"] = task.group;
+        item["Index"] = task.index;
+        item["Left"] = task.left;
+        item["Top"] = task.top;
+        item["Type"] = task.type;
+        item["Width"] = task.width;
+        item["Height"] = task.height;
+        item["MD5"] = task.MD5;
+        item["Size"] = static_cast<Json::Int64>(task.size);
+        item["Device"] = task.device_id;
+        item["SyncPlay"] = task.sync_play;
+        item["Playtime"] = task.play_time;
+        return item;
+    }
+
+    MediaItem task_from_json(const Json::Value &item)
+    {
+        MediaItem task;
+        task.id = item["Id"].asString();
+        task.confirm_url = item["ConfirmURL"].asString();
+        task.download_url = item["DownloadURL"].asString();
+        task.file_name = item["FileName"].asString();
+        task.group = item["Group"].asInt();
+        task.index = item["Index"].asInt();
+        task.left = item["Left"].asInt();
+        task.top = item["Top"].asInt();
+        task.type = item["Type"].asInt();
+        task.width = item["Width"].asInt();
+        task.height = item["Height"].asInt();
+        task.MD5 = item["MD5"].asString();
+        task.size = item["Size"].asInt64();
+        task.device_id = item["Device"].asString();
+        task.sync_play = item["SyncPlay"].asBool();
+        task.play_time = item["Playtime"].asInt();
+        return task;
+    }
+
+    std::string journal_path(const std::string &local_path)
+    {
+        return local_path + ".journal";
+    }
+}
+
+DownloadJournal::DownloadJournal(const std::string &dir)
+    : tasks_path_(dir + "pending.json"), tasks_(Json::objectValue), tasks_dirty_(false)
+{
+    if (!read_json(tasks_path_, tasks_) || !tasks_.isObject())
+    {
+        tasks_ = Json::Value(Json::objectValue);
+    }
+}
+
+std::string DownloadJournal::task_key(const MediaItem &task)
+{
+    return task.device_id + ":" + task.id + ":" + task.MD5;
+}
+
+void DownloadJournal::add_task(const MediaItem &task)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const std::string key = task_key(task);
+    if (tasks_.isMember(key))
+        return;
+    tasks_[key] = task_to_json(task);
+    tasks_dirty_ = true;
+}
+
+void DownloadJournal::remove_task(const MediaItem &task)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const std::string key = task_key(task);
+    if (!tasks_.isMember(key))
+        return;
+    tasks_.removeMember(key);
+    tasks_dirty_ = true;
+}
+
+std::vector<MediaItem> DownloadJournal::pending_tasks()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<MediaItem> tasks;
+    for (const auto &key : tasks_.getMemberNames())
+    {
+        tasks.push_back(task_from_json(tasks_[key]));
+    }
+    return tasks;
+}
+
+void DownloadJournal::flush_tasks()
+{
+    std::lock_guard<std::mutex> save_lock(save_mutex_);
+    std::string content;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!tasks_dirty_)
+            return;
+        Json::StreamWriterBuilder wbuilder;
+        wbuilder["indentation"] = "";
+        content = Json::writeString(wbuilder, tasks_);
+        tasks_dirty_ = false;
+    }
+    if (!AtomicFile::write(tasks_path_, content))
+    {
+        LOGW("Downloader", "保存下载队列失败 %s", tasks_path_.c_str());
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_dirty_ = true;
+    }
+}
+
+bool DownloadJournal::has_progress(const std::string &local_path)
+{
+    return std::filesystem::exists(journal_path(local_path));
+}
+
+bool DownloadJournal::load_progress(const std::string &local_path, Progress &progress)
+{
+    Json::Value root;
+    if (!read_json(journal_path(local_path), root) || !root.isObject())
+        return false;
+
+    progress.url = root["url"].asString();
+    progress.size = root["size"].asUInt64();
+    progress.etag = root["etag"].asString();
+    progress.last_modified = root["lastModified"].asString();
+    progress.ranges.clear();
+    for (const auto &range : root["ranges"])
+    {
+        if (range.isArray() && range.size() == 2)
+        {
+            progress.ranges.emplace_back(range[0].asUInt64(), range[1].asUInt64());
+        }
+    }
+    return true;
+}
+
+bool DownloadJournal::save_progress(const std::string &local_path, const Progress &progress)
+{
+    Json::Value root;
+    root["url"] = progress.url;
+    root["size"] = static_cast<Json::UInt64>(progress.size);
+    root["etag"] = progress.etag;
+    root["lastModified"] = progress.last_modified;
+    Json::Value ranges(Json::arrayValue);
+    for (const auto &range : progress.ranges)
+    {
+        Json::Value item(Json::arrayValue);
+        item.append(static_cast<Json::UInt64>(range.first));
+        item.append(static_cast<Json::UInt64>(range.second));
+        ranges.append(item);
+    }
+    root["ranges"] = ranges;
+
+    Json::StreamWriterBuilder wbuilder;
+    wbuilder["indentation"] = "";
+    return AtomicFile::write(journal_path(local_path), Json::writeString(wbuilder, root));
+}
+
+void DownloadJournal::remove_progress(const std::string &local_path)
+{
+    std::error_code ec;
+    std::filesystem::remove(journal_path(local_path), ec);
+}
+
+bool DownloadJournal::read_json(const std::string &path, Json::Value &root)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    const std::string content = buffer.str();
+
+    Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    std::string errors;
+    return reader->parse(content.c_str(), content.c_str() + content.size(), &root, &errors);
+}
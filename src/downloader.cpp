@@ -1,9 +1,5 @@
 #include "downloader.h"
 #include <httplib.h>
-#include <openssl/evp.h>
-#include <fstream>
-#include <sstream>
-#include <iomanip>
 #include <iostream>
 #include <memory>
 #include <vector>
@@ -12,15 +8,55 @@
 #include <condition_variable>
 #include <queue>
 #include <filesystem>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
 #include "Tools.h"
+#include "atomic_file.h"
+#include "file_digest.h"
+#include "file_writer.h"
+#include "range_downloader.h"
+#include "http_pool.h"
 #include <logger.h>
 
-Downloader::Downloader(const std::string &url_root)
-    : url_root_(url_root), stop_flag_(false)
+namespace
+{
+    std::string file_name_of(const std::string &path)
+    {
+        return std::filesystem::path(path).filename().string();
+    }
+
+    // 小于该大小的文件不做分段下载
+    constexpr uint64_t kMinParallelSize = 1024 * 1024;
+    // 所有传输共用的分段连接数，按正在下载的任务数平分
+    constexpr int kTotalRangeConnections = 6;
+    // 排序源站时预计的文件大小，决定时延和吞吐哪个更重要
+    constexpr uint64_t kTypicalVideoSize = 32 * 1024 * 1024;
+    constexpr uint64_t kTypicalImageSize = 512 * 1024;
+    // 同时竞速的源站数和等待首个响应的时间
+    constexpr size_t kRaceWidth = 2;
+    constexpr int kRaceTimeoutSeconds = 5;
+}
+
+Downloader::Downloader(const std::string &url_root, size_t max_concurrent)
+    : url_root_(url_root), max_concurrent_(std::max<size_t>(1, max_concurrent)), bulk_running_(0),
+      active_transfers_(0), stop_flag_(false), journal_(Tools::get_download_dir()),
+      chunks_(Tools::get_download_dir(), [this](const std::string &name)
+              { return assets_.is_verified(name, name.substr(0, name.find('.'))); }),
+      assets_(Tools::get_download_dir()),
+      origins_(std::make_shared<OriginSelector>())
 {
     work_dir_ = Tools::get_download_dir();
     std::filesystem::create_directory(work_dir_);
-    worker_thread_ = std::thread(&Downloader::worker, this);
+    // 分块清单在后台校验线程生成，下载时只用已缓存的
+    assets_.set_verified_hook([this](const std::string &name, const std::atomic<bool> &cancelled)
+                              { chunks_.refresh(name, cancelled); });
+    for (size_t i = 0; i < max_concurrent_; ++i)
+    {
+        workers_.emplace_back(&Downloader::worker, this);
+    }
 }
 
 Downloader::~Downloader()
@@ -30,317 +66,790 @@ Downloader::~Downloader()
         stop_flag_ = true;
     }
     queue_cv_.notify_all();
-    if (worker_thread_.joinable())
+    for (auto &t : workers_)
     {
-        worker_thread_.join();
+        if (t.joinable())
+            t.join();
     }
 }
 
 void Downloader::setDownloadCallback(DownloadCallback callback)
 {
-    callback_ = callback;
+    {
+        std::lock_guard<std::mutex> lock(callback_mutex_);
+        callback_ = callback;
+    }
+
+    // 断电或重启前未完成的任务重新排队
+    std::vector<MediaItem> pending = journal_.pending_tasks();
+    if (!pending.empty())
+    {
+        LOGI("Downloader", "恢复未完成的下载任务:%d", (int)pending.size());
+    }
+    for (const auto &task : pending)
+    {
+        add_task(task);
+    }
 }
 
 void Downloader::add_task(const MediaItem &task)
 {
-    std::lock_guard<std::mutex> lock(queue_mutex_);
-    tasks_.push(task);
-    queue_cv_.notify_one();
+    add_task(task, task.type == 1 ? Priority::Video : Priority::Visible);
 }
 
-void Downloader::worker()
+void Downloader::add_task(const MediaItem &task, Priority priority)
 {
-    while (true)
     {
-        MediaItem task;
-        {
-            std::unique_lock<std::mutex> lock(queue_mutex_);
-            queue_cv_.wait(lock, [&]
-                           { return stop_flag_ || !tasks_.empty(); });
-
-            if (stop_flag_ && tasks_.empty())
-                return;
-
-            task = tasks_.front();
-            tasks_.pop();
-        }
-        process_task(task);
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        add_locked(task, priority, epochs_[task.device_id]);
     }
+    journal_.flush_tasks();
 }
 
-void Downloader::process_task(const MediaItem &task)
+void Downloader::schedule(const std::string &device_id, const std::vector<MediaItem> &items, bool prefetch)
 {
-    std::string download_url = task.download_url;
-    std::string full_url = (download_url.find("http") == 0) ? download_url : url_root_ + download_url;
-
-    std::filesystem::path p(task.file_name);
-    std::string extension = p.extension().string();
-    std::string local_path = work_dir_ + task.MD5 + extension;
-    int type = task.type;
-
-    if (std::filesystem::exists(local_path))
     {
-        if (verify_md5(local_path, task.MD5))
-        {
-            callback_(task, local_path, true, "");
-            return;
-        }
-        else
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        uint64_t epoch = ++epochs_[device_id];
+        std::set<std::string> names;
+        for (const auto &item : items)
         {
-            std::filesystem::remove(local_path);
+            Priority priority = prefetch ? Priority::Prefetch : (item.type == 1 ? Priority::Video : Priority::Visible);
+            add_locked(item, priority, epoch);
+            names.insert(file_name_of(local_path_for(item)));
         }
+        drop_stale_locked(device_id);
+        // 播放列表中的文件不会被磁盘清理删除
+        assets_.set_references(device_id, names);
     }
+    // 整个播放列表的修改只写一次盘
+    journal_.flush_tasks();
+}
 
-    const int max_retries = 5;
-    int attempt = 0;
-    bool success = false;
-    std::string error_msg;
+void Downloader::add_locked(const MediaItem &task, Priority priority, uint64_t epoch)
+{
+    const std::string local_path = local_path_for(task);
+    std::shared_ptr<Job> &job = jobs_[local_path];
+    if (!job)
+    {
+        job = std::make_shared<Job>();
+        job->local_path = local_path;
+        job->priority = priority;
+        queues_[static_cast<size_t>(priority)].push_back(job);
+        assets_.pin(file_name_of(local_path));
+    }
+    else if (!job->running && priority < job->priority)
+    {
+        // 已在排队的文件被更重要的任务需要，提前
+        auto &old_queue = queues_[static_cast<size_t>(job->priority)];
+        old_queue.erase(std::find(old_queue.begin(), old_queue.end(), job));
+        job->priority = priority;
+        queues_[static_cast<size_t>(priority)].push_back(job);
+    }
 
-    while (attempt < max_retries && !success)
+    // 同一个文件只下载一次，完成后通知所有等待的任务
+    const std::string key = DownloadJournal::task_key(task);
+    auto it = std::find_if(job->waiters.begin(), job->waiters.end(), [&](const Waiter &w)
+                           { return DownloadJournal::task_key(w.task) == key; });
+    if (it != job->waiters.end())
     {
-        attempt++;
-        if (type == 0)
+        it->task = task;
+        it->epoch = epoch;
+    }
+    else
+    {
+        job->waiters.push_back({task, epoch});
+        journal_.add_task(task);
+    }
+    queue_cv_.notify_all();
+}
+
+void Downloader::drop_stale_locked(const std::string &device_id)
+{
+    const uint64_t current = epochs_[device_id];
+    for (auto it = jobs_.begin(); it != jobs_.end();)
+    {
+        std::shared_ptr<Job> job = it->second;
+        auto &waiters = job->waiters;
+        for (auto w = waiters.begin(); w != waiters.end();)
         {
-            // 主题图片，不支持多线程下载
-            success = download_file(full_url, local_path);
+            if (w->task.device_id == device_id && w->epoch < current)
+            {
+                journal_.remove_task(w->task);
+                w = waiters.erase(w);
+            }
+            else
+            {
+                ++w;
+            }
         }
-        else
+
+        if (!waiters.empty())
         {
-            success = download_file_multithread(full_url, local_path);
+            ++it;
+            continue;
         }
 
-        if (success)
+        if (job->running)
         {
-            if (!verify_md5(local_path, task.MD5))
+            // 正在下载的文件已不被任何播放列表需要，中止读取
+            if (!job->cancelled)
             {
-                LOGW("Downloader", "MD5验证不通过。%s ", local_path.c_str());
-
-                success = false;
-                error_msg = "MD5 mismatch";
-                std::filesystem::remove(local_path);
-                break;
+                LOGI("Downloader", "取消过期的下载 %s", job->local_path.c_str());
+                job->cancelled = true;
             }
+            ++it;
         }
         else
         {
-            LOGW("Downloader", "单次下载文件失败 ");
-            error_msg = "Download failed";
+            auto &queue = queues_[static_cast<size_t>(job->priority)];
+            queue.erase(std::find(queue.begin(), queue.end(), job));
+            assets_.unpin(file_name_of(job->local_path));
+            it = jobs_.erase(it);
         }
     }
-
-    callback_(task, local_path, success, error_msg);
 }
 
-size_t Downloader::get_file_size(const std::string &url)
+std::shared_ptr<Downloader::Job> Downloader::next_job_locked(bool &bulk)
 {
-    try
+    const auto now = std::chrono::steady_clock::now();
+
+    // 每次扫描每个源站只检查一次熔断；返回 0 表示可用，否则为最早恢复的等待时间
+    std::map<std::string, std::chrono::milliseconds> waits;
+    auto breaker_wait = [&](const std::string &origin)
     {
-        LOGI("Downloader", "下载地址：%s ", url.c_str());
+        auto it = waits.find(origin);
+        if (it == waits.end())
+            it = waits.emplace(origin, breaker_.check(origin)).first;
+        return it->second;
+    };
+    // 相对地址的任务共用主地址和备用源站，结果对所有这类任务相同
+    bool shared_checked = false;
+    std::vector<std::string> shared_origins;
+    auto job_origins = [&](const MediaItem &task)
+    {
+        if (task.download_url.find("http") == 0)
+            return std::vector<std::string>{HttpPool::parse_url(task.download_url).origin()};
+        if (!shared_checked)
+        {
+            shared_checked = true;
+            std::vector<std::string> roots{url_root_};
+            {
+                std::lock_guard<std::mutex> lock(mirrors_mutex_);
+                roots.insert(roots.end(), mirrors_.begin(), mirrors_.end());
+            }
+            for (const auto &root : roots)
+            {
+                const std::string origin = HttpPool::parse_url(root).origin();
+                if (std::find(shared_origins.begin(), shared_origins.end(), origin) == shared_origins.end())
+                    shared_origins.push_back(origin);
+            }
+        }
+        return shared_origins;
+    };
 
-        httplib::Result res = get_http_client(url.c_str(), 10);
-        if (res && res->has_header("Content-Length"))
+    // 视频和预取最多占用 max_concurrent - 1 个下载位，始终给屏幕需要的图片留一个
+    const size_t bulk_limit = std::max<size_t>(1, max_concurrent_ - 1);
+    for (size_t i = 0; i < queues_.size(); ++i)
+    {
+        if (i != 0 && bulk_running_ >= bulk_limit)
+            break;
+
+        auto &queue = queues_[i];
+        for (auto it = queue.begin(); it != queue.end(); ++it)
         {
-            return std::stoul(res->get_header_value("Content-Length"));
+            std::shared_ptr<Job> job = *it;
+            if (job->not_before > now)
+                continue;
+
+            // 所有源站都在熔断期间时推迟，不占用下载位；下载地址在领取后再排序
+            std::vector<std::string> origins;
+            std::chrono::milliseconds wait = std::chrono::milliseconds::max();
+            for (const auto &origin : job_origins(job->waiters.front().task))
+            {
+                std::chrono::milliseconds w = breaker_wait(origin);
+                if (w.count() == 0)
+                    origins.push_back(origin);
+                else
+                    wait = std::min(wait, w);
+            }
+            if (origins.empty())
+            {
+                job->not_before = now + wait;
+                continue;
+            }
+            job->origins = std::move(origins);
+
+            queue.erase(it);
+            bulk = i != 0;
+            return job;
         }
     }
-    catch (...)
+    return nullptr;
+}
+
+std::chrono::steady_clock::time_point Downloader::next_retry_locked() const
+{
+    const auto now = std::chrono::steady_clock::now();
+    auto next = std::chrono::steady_clock::time_point::max();
+    for (const auto &queue : queues_)
     {
-        return 0;
+        for (const auto &job : queue)
+        {
+            if (job->not_before > now)
+                next = std::min(next, job->not_before);
+        }
     }
-    return 0;
+    return next;
 }
 
-bool Downloader::download_file_multithread(const std::string &url, const std::string &local_path)
+void Downloader::worker()
 {
-    size_t file_size = get_file_size(url);
-    LOGI("Downloader", "获取到文件大小 %d ", file_size);
+    while (true)
+    {
+        std::shared_ptr<Job> job;
+        MediaItem task;
+        std::vector<std::string> urls;
+        std::vector<std::string> origins;
+        bool bulk = false;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            while (!(job = next_job_locked(bulk)))
+            {
+                // 退出时推迟重试的任务留在日志中，下次启动恢复
+                if (stop_flag_)
+                    return;
+                auto next = next_retry_locked();
+                if (next == std::chrono::steady_clock::time_point::max())
+                    queue_cv_.wait(lock);
+                else
+                    queue_cv_.wait_until(lock, next);
+            }
 
-    if (file_size == 0)
-        return false;
+            if (bulk)
+                bulk_running_++;
+            job->running = true;
+            task = job->waiters.front().task;
+            origins = job->origins;
+        }
 
-    const int thread_count = 4;
-    size_t part_size = file_size / thread_count;
+        // 只用领取时熔断未打开的源站（熔断的探测名额已在领取时占用），按预计下载时间排序；
+        // 领取后备用源站被替换时全部尝试
+        const std::vector<std::string> candidates = candidate_urls(task);
+        for (const auto &url : candidates)
+        {
+            if (std::find(origins.begin(), origins.end(), HttpPool::parse_url(url).origin()) != origins.end())
+                urls.push_back(url);
+        }
+        if (urls.empty())
+        {
+            urls = candidates;
+        }
 
-    std::vector<std::thread> threads;
-    std::vector<std::string> temp_files(thread_count);
-    std::vector<bool> download_results(thread_count, false);
+        active_transfers_++;
+        std::string error_msg;
+        Outcome outcome = process_task(task, urls, job->cancelled, error_msg);
+        active_transfers_--;
+        const bool success = outcome == Outcome::Success;
 
-    size_t protocol_pos = url.find("://");
-    if (protocol_pos == std::string::npos)
-    {
-        return 0;
+        std::vector<Waiter> waiters;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            if (bulk)
+                bulk_running_--;
+            job->running = false;
+
+            if (!success && job->cancelled && !job->waiters.empty())
+            {
+                // 中止期间又被新的播放列表需要，重新排队
+                job->cancelled = false;
+                queues_[static_cast<size_t>(job->priority)].push_back(job);
+            }
+            else if (outcome == Outcome::Retry && !job->cancelled && retry_.should_retry(job->attempts + 1))
+            {
+                // 推迟重试，期间下载位留给其他任务
+                job->attempts++;
+                std::chrono::milliseconds delay = retry_.delay(job->attempts);
+                job->not_before = std::chrono::steady_clock::now() + delay;
+                queues_[static_cast<size_t>(job->priority)].push_back(job);
+                LOGW("Downloader", "%lld 毫秒后第 %d 次重试 %s", (long long)delay.count(), job->attempts + 1, job->local_path.c_str());
+            }
+            else
+            {
+                waiters.swap(job->waiters);
+                jobs_.erase(job->local_path);
+                if (success)
+                {
+                    assets_.touch(file_name_of(job->local_path));
+                }
+                assets_.unpin(file_name_of(job->local_path));
+                for (const auto &w : waiters)
+                {
+                    journal_.remove_task(w.task);
+                }
+            }
+        }
+        queue_cv_.notify_all();
+        journal_.flush_tasks();
+
+        for (const auto &w : waiters)
+        {
+            notify(w.task, job->local_path, success, error_msg);
+        }
     }
+}
 
-    std::string protocol = url.substr(0, protocol_pos);
-    std::string host_port_path = url.substr(protocol_pos + 3);
+std::string Downloader::full_url_for(const MediaItem &task) const
+{
+    return task.download_url.find("http") == 0 ? task.download_url : url_root_ + task.download_url;
+}
 
-    size_t slash_pos = host_port_path.find('/');
-    std::string path = host_port_path.substr(slash_pos);
-    std::string host_port = host_port_path.substr(0, slash_pos);
-    size_t colon_pos = host_port.find(':');
-    std::string host;
-    int port = 80;
-    if (colon_pos != std::string::npos)
+std::vector<std::string> Downloader::candidate_urls(const MediaItem &task)
+{
+    std::vector<std::string> urls{full_url_for(task)};
+    if (task.download_url.find("http") != 0)
     {
-        host = host_port.substr(0, colon_pos);
-        port = std::stoi(host_port.substr(colon_pos + 1));
+        std::lock_guard<std::mutex> lock(mirrors_mutex_);
+        for (const auto &root : mirrors_)
+        {
+            std::string url = root + task.download_url;
+            if (std::find(urls.begin(), urls.end(), url) == urls.end())
+                urls.push_back(url);
+        }
     }
-    else
+    origins_->rank(urls, task.type == 1 ? kTypicalVideoSize : kTypicalImageSize);
+    return urls;
+}
+
+std::vector<std::string> Downloader::race_origins(std::vector<std::string> urls)
+{
+    std::vector<std::string> origins;
+    for (const auto &url : urls)
     {
-        host = host_port;
-        port = (protocol == "https") ? 443 : 80;
+        origins.push_back(HttpPool::parse_url(url).origin());
     }
+    if (!origins_->begin_race(origins))
+        return urls;
 
-    for (int i = 0; i < thread_count; ++i)
+    struct Race
     {
-        size_t start = i * part_size;
-        size_t end = (i == thread_count - 1) ? file_size - 1 : (start + part_size - 1);
+        std::mutex mutex;
+        std::condition_variable cv;
+        size_t pending = 0;
+        int winner = -1;
+    };
+    auto race = std::make_shared<Race>();
+    race->pending = std::min(kRaceWidth, urls.size());
+
+    // 请求独立于连接池，落后的请求在后台结束，时延照常计入统计
+    for (size_t i = 0; i < race->pending; ++i)
+    {
+        std::thread([race, selector = origins_, url = urls[i], i]()
+                    {
+            HttpPool::Url parts = HttpPool::parse_url(url);
+            httplib::Client client(parts.origin());
+            client.set_connection_timeout(kRaceTimeoutSeconds);
+            client.set_read_timeout(kRaceTimeoutSeconds);
+            auto start = std::chrono::steady_clock::now();
+            bool ok = false;
+            client.Get(parts.path, {{"Range", "bytes=0-0"}, {"Accept-Encoding", "identity"}},
+                       [&](const httplib::Response &response)
+                       {
+                           ok = response.status == 206 || response.status == 200;
+                           return false; // 只需要响应头
+                       },
+                       [](const char *, size_t)
+                       { return false; });
+            if (ok)
+                selector->report_latency(parts.origin(), std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+            else
+                selector->report_failure(parts.origin());
+
+            std::lock_guard<std::mutex> lock(race->mutex);
+            race->pending--;
+            if (ok && race->winner < 0)
+                race->winner = static_cast<int>(i);
+            race->cv.notify_all(); })
+            .detach();
+    }
 
-        temp_files[i] = local_path + ".part" + std::to_string(i);
+    std::unique_lock<std::mutex> lock(race->mutex);
+    race->cv.wait_for(lock, std::chrono::seconds(kRaceTimeoutSeconds), [&]
+                      { return race->winner >= 0 || race->pending == 0; });
+    if (race->winner > 0)
+    {
+        LOGI("Downloader", "源站竞速 %s 最先响应", urls[race->winner].c_str());
+        std::rotate(urls.begin(), urls.begin() + race->winner, urls.begin() + race->winner + 1);
+    }
+    return urls;
+}
 
-        threads.emplace_back([=, &download_results]()
-                             {
-            try {
-                httplib::Client client(host,port);
-                client.set_connection_timeout(10);
-                client.set_read_timeout(30);
-                
-                if (protocol == "https") {
-                    client.enable_server_certificate_verification(false);
-                }
+std::string Downloader::local_path_for(const MediaItem &task) const
+{
+    std::filesystem::path p(task.file_name);
+    return work_dir_ + task.MD5 + p.extension().string();
+}
 
-                std::string range = "bytes=" + std::to_string(start) + "-" + std::to_string(end);
-                auto res = client.Get(path.c_str(), {
-                    {"Range", range}
-                });
-
-                if (res && res->status == 206) {
-                    std::ofstream out(temp_files[i], std::ios::binary);
-                    if (out) {
-                        out << res->body;
-                        out.close();
-                        download_results[i] = true;
-                    }
-                }
-            } catch (...) {
-                download_results[i] = false;
-            } });
+void Downloader::notify(const MediaItem &task, const std::string &local_path, bool success, const std::string &error)
+{
+    std::lock_guard<std::mutex> lock(callback_mutex_);
+    if (callback_)
+    {
+        callback_(task, local_path, success, error);
     }
+}
 
-    for (auto &t : threads)
+Downloader::Outcome Downloader::process_task(const MediaItem &task, const std::vector<std::string> &urls,
+                                             const std::atomic<bool> &cancelled, std::string &error_msg)
+{
+    std::string local_path = local_path_for(task);
+    int type = task.type;
+
+    // 下载写入临时文件，校验通过后才发布到最终路径；
+    // 旧版本直接在最终路径上续传，留有下载日志的按未完成文件丢弃
+    const std::string part_path = local_path + ".part";
+    if (journal_.has_progress(local_path))
     {
-        if (t.joinable())
-            t.join();
+        std::filesystem::remove(local_path);
+        journal_.remove_progress(local_path);
     }
 
-    // 检查所有部分是否下载成功
-    for (bool result : download_results)
+    if (std::filesystem::exists(local_path))
     {
-        if (!result)
+        // 校验后未被修改过的文件直接使用，不再重新计算 MD5
+        const std::string file_name = file_name_of(local_path);
+        if (assets_.is_verified(file_name, task.MD5))
         {
-            // 清理临时文件
-            for (const auto &temp_file : temp_files)
-            {
-                std::filesystem::remove(temp_file);
-            }
-            return false;
+            return Outcome::Success;
+        }
+        if (verify_md5(local_path, task.MD5))
+        {
+            assets_.mark_verified(file_name, task.MD5);
+            return Outcome::Success;
+        }
+        else
+        {
+            std::filesystem::remove(local_path);
         }
     }
 
-    // 合并文件
-    std::ofstream output(local_path, std::ios::binary);
-    if (!output.is_open())
+    // 下载过程中同步计算 MD5，完成后无需再读一遍文件；失败由 worker 推迟重试
+    // 局域网内其他播放器有校验过的同一文件时优先从对方获取，失败再回源
+    std::string md5;
+    if (!fetch_from_peer(task, part_path, md5, cancelled))
     {
-        return false;
-    }
+        // 多个源站时定期竞速，最先响应的先用；失败时换下一个源站，分段下载从已完成的区间继续
+        const std::vector<std::string> candidates = urls.size() > 1 ? race_origins(urls) : urls;
+        bool success = false;
+        bool retry = false;    // 有源站因网络或本地错误失败，稍后重试可能成功
+        bool mismatch = false; // 有源站提供的文件 MD5 不符
+        for (size_t i = 0; i < candidates.size() && !success && !cancelled; ++i)
+        {
+            const std::string &full_url = candidates[i];
+            const std::string origin = HttpPool::parse_url(full_url).origin();
+            auto start = std::chrono::steady_clock::now();
+            Failure failure = Failure::None;
+            if (type != 1)
+            {
+                // 主题图片/模板，不支持多线程下载
+                success = download_file(full_url, part_path, md5, cancelled, failure, limiter_);
+            }
+            else
+            {
+                success = download_file_multithread(full_url, part_path, md5, cancelled, failure);
+            }
 
-    for (int i = 0; i < thread_count; ++i)
+            if (success)
+            {
+                LOGI("Downloader", "计算的MD5:%s 期望的MD5:%s", md5.c_str(), task.MD5.c_str());
+            }
+            if (success && md5 != task.MD5)
+            {
+                // 源站上的文件与任务不符（如镜像未同步）；临时文件可能由多个源站的内容拼成，
+                // 整体丢弃后从下一个源站重新下载
+                LOGW("Downloader", "MD5验证不通过 %s", full_url.c_str());
+                success = false;
+                mismatch = true;
+                breaker_.record_failure(origin);
+                origins_->report_failure(origin);
+                std::error_code ec;
+                std::filesystem::remove(part_path, ec);
+                journal_.remove_progress(part_path);
+                if (i + 1 < candidates.size())
+                {
+                    LOGW("Downloader", "源站文件不符，切换到 %s", candidates[i + 1].c_str());
+                }
+            }
+            else if (success)
+            {
+                breaker_.record_success(origin);
+                std::error_code ec;
+                origins_->report_transfer(origin, std::filesystem::file_size(part_path, ec),
+                                          std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            }
+            else if (!cancelled)
+            {
+                // 4xx 和本地错误与源站是否可用无关，不计入熔断
+                if (failure == Failure::Network)
+                {
+                    breaker_.record_failure(origin);
+                    origins_->report_failure(origin);
+                }
+                retry = retry || failure != Failure::Rejected;
+                if (i + 1 < candidates.size())
+                {
+                    LOGW("Downloader", "源站下载失败，切换到 %s", candidates[i + 1].c_str());
+                }
+            }
+        }
+
+        if (!success)
+        {
+            LOGW("Downloader", "单次下载文件失败 ");
+            if (!cancelled && !retry)
+            {
+                // 所有源站都拒绝提供该文件或文件不符，重试无意义
+                error_msg = mismatch ? "MD5 mismatch" : "Rejected by server";
+                std::error_code ec;
+                std::filesystem::remove(part_path, ec);
+                journal_.remove_progress(part_path);
+                return Outcome::Failed;
+            }
+            error_msg = cancelled ? "Cancelled" : "Download failed";
+            if (!journal_.has_progress(part_path))
+            {
+                // 没有续传日志的临时文件无法再利用
+                std::error_code ec;
+                std::filesystem::remove(part_path, ec);
+            }
+            return Outcome::Retry;
+        }
+    }
+    if (!AtomicFile::publish(part_path, local_path))
     {
-        std::ifstream part(temp_files[i], std::ios::binary);
-        output << part.rdbuf();
-        part.close();
-        std::filesystem::remove(temp_files[i]);
+        LOGW("Downloader", "发布文件失败 %s %s", local_path.c_str(), strerror(errno));
+        error_msg = "Publish failed";
+        std::filesystem::remove(part_path);
+        return Outcome::Failed;
     }
-
-    output.close();
-    return true;
+    assets_.mark_verified(file_name_of(local_path), md5);
+    return Outcome::Success;
 }
 
-bool Downloader::download_file(const std::string &url, const std::string &local_path)
+bool Downloader::probe_resource(const std::string &url, ResourceProbe::ResourceInfo &info)
 {
     try
     {
-        httplib::Result res = get_http_client(url, 60);
-        if (res && res->status == 200)
+        LOGI("Downloader", "下载地址：%s ", url.c_str());
+
+        HttpPool::Url parts = HttpPool::parse_url(url);
+        HttpPool::Lease client = HttpPool::instance().acquire(parts, 10);
+        if (!probe_.probe(url, parts.origin(), *client, parts.path, info))
         {
-            std::ofstream out(local_path, std::ios::binary);
-            if (out)
-            {
-                out << res->body;
-                return true;
-            }
+            client.discard();
+            return false;
         }
+        return true;
     }
     catch (...)
     {
         return false;
     }
-    return false;
 }
 
-bool Downloader::verify_md5(const std::string &file_path, const std::string &expected_md5)
+bool Downloader::download_file_multithread(const std::string &url, const std::string &local_path, std::string &md5,
+                                           const std::atomic<bool> &cancelled, Failure &failure)
 {
-    std::ifstream file(file_path, std::ios::binary);
-    if (!file)
+    ResourceProbe::ResourceInfo info;
+    if (!probe_resource(url, info))
+    {
+        failure = info.status >= 400 && info.status < 500 ? Failure::Rejected : Failure::Network;
         return false;
+    }
 
-    EVP_MD_CTX *md5_ctx = EVP_MD_CTX_new();
-    if (!md5_ctx)
-        return false;
+    // 不支持分段或文件较小时单线程下载
+    if (!info.accept_ranges || info.size < kMinParallelSize)
+    {
+        journal_.remove_progress(local_path);
+        return download_file(url, local_path, md5, cancelled, failure, limiter_);
+    }
+    uint64_t file_size = info.size;
+
+    HttpPool::Url parts = HttpPool::parse_url(url);
+
+    // 大小与日志一致且文件仍在时断点续传；同一地址还需校验信息一致，
+    // 换用其他源站时各源站的校验信息不可比，沿用已下载的区间，内容由最终的 MD5 保证
+    DownloadJournal::Progress progress;
+    bool resume = journal_.load_progress(local_path, progress) &&
+                  progress.size == file_size &&
+                  (progress.url != url ||
+                   ((progress.etag.empty() || info.etag.empty() || progress.etag == info.etag) &&
+                    (progress.last_modified.empty() || info.last_modified.empty() || progress.last_modified == info.last_modified))) &&
+                  std::filesystem::exists(local_path) &&
+                  std::filesystem::file_size(local_path) == file_size;
+    if (resume && progress.url != url)
+    {
+        LOGI("Downloader", "从其他源站继续下载 %s", url.c_str());
+        progress.url = url;
+        progress.etag = info.etag;
+        progress.last_modified = info.last_modified;
+        journal_.save_progress(local_path, progress);
+    }
+    if (!resume)
+    {
+        progress = DownloadJournal::Progress();
+        progress.url = url;
+        progress.size = file_size;
+        progress.etag = info.etag;
+        progress.last_modified = info.last_modified;
+    }
 
-    if (EVP_DigestInit_ex(md5_ctx, EVP_md5(), NULL) != 1)
+    int fd = ::open(local_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC | (resume ? 0 : O_TRUNC), 0644);
+    if (fd < 0)
     {
-        EVP_MD_CTX_free(md5_ctx);
+        failure = Failure::Local;
         return false;
     }
 
-    char buf[4096];
-    while (file.read(buf, sizeof(buf)))
+    if (!resume)
     {
-        if (EVP_DigestUpdate(md5_ctx, buf, file.gcount()) != 1)
+        // 预分配整个文件，各分段直接写入对应位置，不再生成分段文件再合并
+        int err = posix_fallocate(fd, 0, file_size);
+        if (err != 0 && ftruncate(fd, file_size) != 0)
         {
-            EVP_MD_CTX_free(md5_ctx);
+            LOGW("Downloader", "预分配文件失败 %s", strerror(err));
+            ::close(fd);
+            std::filesystem::remove(local_path);
+            failure = Failure::Local;
             return false;
         }
+        // 重新导出的素材大部分内容不变，只下载本地没有的块
+        progress.ranges = seed_from_chunks(url, local_path, fd, file_size, cancelled);
+        journal_.save_progress(local_path, progress);
     }
-    if (file.gcount() > 0)
+
+    RangeDownloader ranges([parts]()
+                           { return HttpPool::instance().acquire(parts, 30); },
+                           parts.path, file_size);
+    // 多个传输同时进行时平分连接，屏幕需要的小文件不会被大文件挤占
+    ranges.set_cancel_flag(&cancelled);
+    RateLimiter::Transfer throttle(limiter_);
+    ranges.set_throttle([&throttle, &cancelled](size_t len)
+                        { return throttle.acquire(len, &cancelled); });
+    ranges.set_worker_limit([this]()
+                            { return kTotalRangeConnections / std::max(1, active_transfers_.load()); });
+    ranges.resume(progress.ranges, progress.etag, progress.last_modified);
+    ranges.set_checkpoint([&](const RangeDownloader::Ranges &done, const std::string &etag, const std::string &last_modified)
+                          {
+        progress.ranges = done;
+        progress.etag = etag;
+        progress.last_modified = last_modified;
+        journal_.save_progress(local_path, progress); });
+
+    bool received = ranges.run(fd, md5);
+    bool success = (::close(fd) == 0) && received;
+    if (!success)
     {
-        if (EVP_DigestUpdate(md5_ctx, buf, file.gcount()) != 1)
-        {
-            EVP_MD_CTX_free(md5_ctx);
-            return false;
-        }
+        failure = received ? Failure::Local : Failure::Network;
     }
 
-    unsigned char result[EVP_MAX_MD_SIZE];
-    unsigned int result_len;
-    if (EVP_DigestFinal_ex(md5_ctx, result, &result_len) != 1)
+    if (success || ranges.changed())
     {
-        EVP_MD_CTX_free(md5_ctx);
-        return false;
+        journal_.remove_progress(local_path);
+    }
+    if (ranges.changed())
+    {
+        std::filesystem::remove(local_path);
+    }
+    if (!success)
+    {
+        probe_.invalidate(url);
+    }
+    return success;
+}
+
+RangeDownloader::Ranges Downloader::seed_from_chunks(const std::string &url, const std::string &local_path, int fd,
+                                                     uint64_t file_size, const std::atomic<bool> &cancelled)
+{
+    // 清单可选，服务器没有时照常整体下载
+    httplib::Result res = get_http_client(url + ".chunks", 10);
+    if (!res || res->status != 200)
+        return {};
+
+    Json::Value root;
+    Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    std::string errors;
+    ChunkManifest manifest;
+    if (!reader->parse(res->body.c_str(), res->body.c_str() + res->body.size(), &root, &errors) ||
+        !manifest.parse(root) || manifest.size != file_size)
+    {
+        LOGW("Downloader", "分块清单无效 %s.chunks", url.c_str());
+        return {};
     }
 
-    EVP_MD_CTX_free(md5_ctx);
+    // 临时文件去掉 .part 即资源文件名
+    const std::filesystem::path name = std::filesystem::path(local_path).stem();
+    return chunks_.seed(manifest, fd, name.extension().string(), name.string(), cancelled);
+}
 
-    std::ostringstream md5_str;
-    for (unsigned int i = 0; i < result_len; ++i)
+bool Downloader::download_file(const std::string &url, const std::string &local_path, std::string &md5,
+                               const std::atomic<bool> &cancelled, Failure &failure, RateLimiter &limiter)
+{
+    failure = Failure::Network;
+    try
     {
-        md5_str << std::hex << std::setw(2) << std::setfill('0') << (int)result[i];
+        Md5Digest digest;
+        RateLimiter::Transfer throttle(limiter);
+        FileWriter out(local_path, [&digest](uint64_t, const char *data, size_t len)
+                       { digest.update(data, len); });
+        if (!out.is_open())
+        {
+            failure = Failure::Local;
+            return false;
+        }
+
+        // 响应处理器返回 false 时结果中不带响应，状态码在这里记下
+        int status = 0;
+        bool write_failed = false;
+        httplib::Result res = get_http_client(
+            url, 60,
+            [&status](const httplib::Response &response)
+            {
+                status = response.status;
+                return response.status == 200;
+            },
+            [&out, &throttle, &cancelled, &write_failed](const char *data, size_t len)
+            {
+                if (!throttle.acquire(len, &cancelled))
+                    return false;
+                write_failed = !out.write(data, len);
+                return !write_failed;
+            });
+        if (res && res->status == 200 && out.close())
+        {
+            md5 = digest.final_hex();
+            return true;
+        }
+        if (write_failed || (res && res->status == 200))
+            failure = Failure::Local;
+        else if (status >= 400 && status < 500)
+            failure = Failure::Rejected;
     }
+    catch (...)
+    {
+        return false;
+    }
+    return false;
+}
+
+bool Downloader::verify_md5(const std::string &file_path, const std::string &expected_md5)
+{
+    std::string md5 = Md5Digest::file_md5(file_path);
 
-    LOGI("Downloader", "计算的MD5:%s 期望的MD5:%s", md5_str.str().c_str(), expected_md5.c_str());
+    LOGI("Downloader", "计算的MD5:%s 期望的MD5:%s", md5.c_str(), expected_md5.c_str());
 
-    return md5_str.str() == expected_md5;
+    return !md5.empty() && md5 == expected_md5;
 }
 
 void Downloader::update_url(const std::string &url)
@@ -348,45 +857,100 @@ void Downloader::update_url(const std::string &url)
     url_root_ = url;
 }
 
-httplib::Result Downloader::get_http_client(const std::string &url, int timeout)
+void Downloader::set_mirrors(const std::vector<std::string> &roots)
 {
-    // 解析URL获取主机和端口
-    size_t protocol_pos = url.find("://");
-    if (protocol_pos == std::string::npos)
-    {
-        throw std::runtime_error("Invalid URL format");
-    }
+    std::lock_guard<std::mutex> lock(mirrors_mutex_);
+    mirrors_ = roots;
+    LOGI("Downloader", "备用源站数:%d", (int)mirrors_.size());
+}
 
-    std::string protocol = url.substr(0, protocol_pos);
-    std::string host_port_path = url.substr(protocol_pos + 3);
+void Downloader::set_disk_quota(uint64_t bytes)
+{
+    assets_.set_quota(bytes);
+}
 
-    size_t slash_pos = host_port_path.find('/');
-    std::string host_port = host_port_path.substr(0, slash_pos);
-    std::string path = host_port_path.substr(slash_pos);
+void Downloader::set_rate_limit(const RateLimiter::Config &config)
+{
+    limiter_.configure(config);
+}
 
-    size_t colon_pos = host_port.find(':');
-    std::string host;
-    int port = 80;
-    if (colon_pos != std::string::npos)
-    {
-        host = host_port.substr(0, colon_pos);
-        port = std::stoi(host_port.substr(colon_pos + 1));
-    }
-    else
+void Downloader::report_network_rtt(int rtt_ms)
+{
+    limiter_.report_rtt(rtt_ms);
+}
+
+void Downloader::enable_peer_sharing(int port)
+{
+    // 文件名即 MD5，只提供校验后未被修改过的文件
+    peers_.reset(new PeerCache(
+        work_dir_,
+        [this]()
+        { return assets_.verified_names(); },
+        [this](const std::string &name)
+        { return assets_.is_verified(name, name.substr(0, name.find('.'))); },
+        port));
+}
+
+void Downloader::enable_multicast_push()
+{
+    // 已有校验过的同名文件时不接收；收齐后按已校验登记，之后的下载任务直接使用
+    push_.reset(new MulticastPush(
+        work_dir_,
+        [this](const std::string &name)
+        { return !assets_.is_verified(name, name.substr(0, name.find('.'))); },
+        [this](const std::string &name, const std::string &md5)
+        { assets_.mark_verified(name, md5); }));
+}
+
+bool Downloader::push_asset(const std::string &name, uint64_t rate)
+{
+    if (!push_ || !assets_.is_verified(name, name.substr(0, name.find('.'))))
     {
-        host = host_port;
-        port = (protocol == "https") ? 443 : 80;
+        LOGW("Downloader", "没有可推送的文件 %s", name.c_str());
+        return false;
     }
+    push_->push(name, rate);
+    return true;
+}
 
-    httplib::Client client(host, port);
-    client.set_connection_timeout(10);
-    client.set_read_timeout(timeout);
+bool Downloader::fetch_from_peer(const MediaItem &task, const std::string &part_path, std::string &md5,
+                                 const std::atomic<bool> &cancelled)
+{
+    // 从服务器续传中的文件不改用其他来源
+    if (!peers_ || journal_.has_progress(part_path))
+        return false;
 
-    if (protocol == "https")
+    for (const std::string &url : peers_->locate(file_name_of(local_path_for(task))))
     {
-        client.enable_server_certificate_verification(false);
+        if (cancelled)
+            break;
+        Failure failure;
+        if (download_file(url, part_path, md5, cancelled, failure, lan_limiter_) && md5 == task.MD5)
+        {
+            LOGI("Downloader", "从局域网播放器获取 %s", url.c_str());
+            return true;
+        }
+        std::error_code ec;
+        std::filesystem::remove(part_path, ec);
     }
+    return false;
+}
 
-    httplib::Result res = client.Get(path.c_str());
+httplib::Result Downloader::get_http_client(const std::string &url, int timeout,
+                                            httplib::ResponseHandler response_handler,
+                                            httplib::ContentReceiver receiver)
+{
+    HttpPool::Url parts = HttpPool::parse_url(url);
+    HttpPool::Lease client = HttpPool::instance().acquire(parts, timeout);
+    const std::string &path = parts.path;
+
+    httplib::Result res = receiver
+                              ? client->Get(path.c_str(), {{"Accept-Encoding", HttpPool::accept_encoding()}},
+                                            std::move(response_handler), std::move(receiver))
+                              : client->Get(path.c_str());
+    if (!res)
+    {
+        client.discard();
+    }
     return res;
 }
@@ -0,0 +1,201 @@
+#include "file_digest.h"
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace
+{
+    // 每次映射的窗口大小，计算当前窗口时预读下一个
+    constexpr uint64_t kMapWindow = 8 * 1024 * 1024;
+}
+
+Md5Digest::Md5Digest() : ctx_(EVP_MD_CTX_new()), ok_(false)
+{
+    reset();
+}
+
+Md5Digest::~Md5Digest()
+{
+    if (ctx_)
+    {
+        EVP_MD_CTX_free(ctx_);
+    }
+}
+
+void Md5Digest::reset()
+{
+    ok_ = ctx_ && EVP_DigestInit_ex(ctx_, EVP_md5(), NULL) == 1;
+}
+
+bool Md5Digest::update(const void *data, size_t len)
+{
+    if (ok_ && len > 0)
+    {
+        ok_ = EVP_DigestUpdate(ctx_, data, len) == 1;
+    }
+    return ok_;
+}
+
+std::string Md5Digest::final_hex()
+{
+    unsigned char result[EVP_MAX_MD_SIZE];
+    unsigned int result_len = 0;
+    if (!ok_ || EVP_DigestFinal_ex(ctx_, result, &result_len) != 1)
+    {
+        ok_ = false;
+        return "";
+    }
+    ok_ = false;
+
+    std::ostringstream md5_str;
+    for (unsigned int i = 0; i < result_len; ++i)
+    {
+        md5_str << std::hex << std::setw(2) << std::setfill('0') << (int)result[i];
+    }
+    return md5_str.str();
+}
+
+std::string Md5Digest::file_md5(const std::string &file_path, const std::function<void(uint64_t)> &progress,
+                                const std::atomic<bool> *cancelled)
+{
+    int fd = ::open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return "";
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        return "";
+    }
+    const uint64_t size = st.st_size;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    Md5Digest md5;
+    bool ok = true;
+    uint64_t offset = 0;
+    std::vector<char> buf;
+    while (ok && offset < size)
+    {
+        if (cancelled && *cancelled)
+        {
+            ok = false;
+            break;
+        }
+        const uint64_t len = std::min(kMapWindow, size - offset);
+        if (offset + len < size)
+        {
+            posix_fadvise(fd, offset + len, std::min(kMapWindow, size - offset - len), POSIX_FADV_WILLNEED);
+        }
+
+        void *map = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, offset);
+        if (map != MAP_FAILED)
+        {
+            madvise(map, len, MADV_SEQUENTIAL);
+            ok = md5.update(map, len);
+            munmap(map, len);
+        }
+        else
+        {
+            // 无法映射时退回普通读取
+            buf.resize(len);
+            ssize_t n = pread(fd, buf.data(), len, offset);
+            ok = n == static_cast<ssize_t>(len) && md5.update(buf.data(), len);
+        }
+
+        offset += len;
+        if (progress)
+            progress(len);
+    }
+    ::close(fd);
+
+    return ok ? md5.final_hex() : "";
+}
+
+OrderedDigest::OrderedDigest(Reader reader)
+    : cursor_(0), reader_(std::move(reader)), failed_(false), catching_(false)
+{
+}
+
+void OrderedDigest::on_data(uint64_t offset, const char *data, size_t len)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    const uint64_t end = offset + len;
+    if (end <= cursor_)
+    {
+        return;
+    }
+
+    if (offset <= cursor_ && !catching_)
+    {
+        // 顺序到达，直接使用内存中的数据
+        const uint64_t skip = cursor_ - offset;
+        md5_.update(data + skip, len - skip);
+        cursor_ = end;
+    }
+    else
+    {
+        // 正在从文件追平时摘要由追平的线程推进，数据已落盘，同样登记为待读回
+        uint64_t &pending_end = pending_[offset];
+        pending_end = std::max(pending_end, end);
+    }
+    catch_up(lock);
+}
+
+void OrderedDigest::on_written(uint64_t offset, uint64_t len)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    uint64_t &pending_end = pending_[offset];
+    pending_end = std::max(pending_end, offset + len);
+    catch_up(lock);
+}
+
+void OrderedDigest::catch_up(std::unique_lock<std::mutex> &lock)
+{
+    // 同一时间只有一个线程追平；读文件时释放锁，其他分段的写入不受影响
+    if (catching_)
+        return;
+    catching_ = true;
+    std::vector<char> buf;
+    while (!failed_ && !pending_.empty() && pending_.begin()->first <= cursor_)
+    {
+        const uint64_t end = pending_.begin()->second;
+        pending_.erase(pending_.begin());
+
+        if (buf.empty())
+            buf.resize(64 * 1024);
+
+        while (cursor_ < end)
+        {
+            const uint64_t position = cursor_;
+            const size_t n = static_cast<size_t>(std::min<uint64_t>(buf.size(), end - position));
+            lock.unlock();
+            const bool ok = reader_ && reader_(position, buf.data(), n);
+            lock.lock();
+            if (!ok)
+            {
+                failed_ = true;
+                break;
+            }
+            md5_.update(buf.data(), n);
+            cursor_ = position + n;
+        }
+    }
+    catching_ = false;
+}
+
+std::string OrderedDigest::finish(uint64_t total_size)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    catch_up(lock);
+    if (failed_ || cursor_ != total_size)
+    {
+        return "";
+    }
+    return md5_.final_hex();
+}
@@ -0,0 +1,80 @@
+#include "file_writer.h"
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+FileWriter::FileWriter(const std::string &path, FlushHandler on_flush)
+    : owns_fd_(true), on_flush_(std::move(on_flush)), offset_(0)
+{
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    buffer_.reserve(kBufferSize);
+}
+
+FileWriter::FileWriter(int fd, uint64_t offset, FlushHandler on_flush)
+    : fd_(fd), owns_fd_(false), on_flush_(std::move(on_flush)), offset_(offset)
+{
+    buffer_.reserve(kBufferSize);
+}
+
+FileWriter::~FileWriter()
+{
+    close();
+}
+
+bool FileWriter::is_open() const
+{
+    return fd_ >= 0;
+}
+
+bool FileWriter::write(const char *data, size_t len)
+{
+    if (fd_ < 0)
+        return false;
+    while (len > 0)
+    {
+        size_t n = std::min(len, kBufferSize - buffer_.size());
+        buffer_.insert(buffer_.end(), data, data + n);
+        data += n;
+        len -= n;
+        if (buffer_.size() == kBufferSize && !flush())
+            return false;
+    }
+    return true;
+}
+
+bool FileWriter::close()
+{
+    if (fd_ < 0)
+        return false;
+    bool ok = flush();
+    if (owns_fd_)
+    {
+        ok = (::close(fd_) == 0) && ok;
+    }
+    fd_ = -1;
+    return ok;
+}
+
+bool FileWriter::flush()
+{
+    size_t done = 0;
+    while (done < buffer_.size())
+    {
+        ssize_t n = ::pwrite(fd_, buffer_.data() + done, buffer_.size() - done, offset_ + done);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        done += n;
+    }
+    if (on_flush_ && !buffer_.empty())
+    {
+        on_flush_(offset_, buffer_.data(), buffer_.size());
+    }
+    offset_ += buffer_.size();
+    buffer_.clear();
+    return true;
+}
@@ -3,35 +3,15 @@
 #include <sstream>
 #include <json/json.h>
 #include <logger.h>
+#include "http_pool.h"
 
 HttpClient::HttpClient(const std::string &url_root) : url_root_(url_root)
 {
     // 解析URL获取主机和端口
-    size_t protocol_pos = url_root.find("://");
-    if (protocol_pos == std::string::npos)
-    {
-        throw std::runtime_error("Invalid URL format");
-    }
-
-    std::string protocol = url_root.substr(0, protocol_pos);
-    std::string host_port_path = url_root.substr(protocol_pos + 3);
-
-    size_t slash_pos = host_port_path.find('/');
-    std::string host_port = host_port_path.substr(0, slash_pos);
-
-    size_t colon_pos = host_port.find(':');
-    if (colon_pos != std::string::npos)
-    {
-        host_ = host_port.substr(0, colon_pos);
-        port_ = std::stoi(host_port.substr(colon_pos + 1));
-    }
-    else
-    {
-        host_ = host_port;
-        port_ = (protocol == "https") ? 443 : 80;
-    }
-
-    is_https_ = (protocol == "https");
+    HttpPool::Url parts = HttpPool::parse_url(url_root);
+    host_ = parts.host;
+    port_ = parts.port;
+    is_https_ = (parts.protocol == "https");
 }
 
 bool HttpClient::getSystemInfo(SystemInfo &info, std::string &error_msg)
@@ -84,22 +64,18 @@ bool HttpClient::performGetRequest(const std::string &path, std::string &respons
     try
     {
         LOGI("HttpClient", "http:%s", path.c_str());
-        httplib::Client client(host_, port_); // scheme + host
 
-        // 设置超时（单位：秒）
-        client.set_connection_timeout(10);
-        client.set_read_timeout(10);
-        client.set_write_timeout(10);
-
-        // 如果是HTTPS，需要启用SSL
-        if (is_https_)
-        {
-            client.enable_server_certificate_verification(false); // 禁用证书验证（生产环境应启用）
-        }
+        // 从连接池借用到服务器的长连接，超时 10 秒
+        HttpPool::Url url;
+        url.protocol = is_https_ ? "https" : "http";
+        url.host = host_;
+        url.port = port_;
+        HttpPool::Lease client = HttpPool::instance().acquire(url, 10);
 
-        auto res = client.Get(path.c_str());
+        auto res = client->Get(path.c_str());
         if (!res)
         {
+            client.discard();
             error_msg = "HTTP请求失败: 无法连接到服务器";
             return false;
         }
@@ -0,0 +1,241 @@
+#include "http_pool.h"
+#include <stdexcept>
+#include <algorithm>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <logger.h>
+
+namespace
+{
+    constexpr size_t kDefaultMaxPerOrigin = 8;
+    // 空闲连接超过该时间不再复用，服务器通常已关闭
+    constexpr std::chrono::seconds kIdleTimeout(60);
+    constexpr std::chrono::minutes kDnsTtl(5);
+}
+
+std::string HttpPool::Url::origin() const
+{
+    return protocol + "://" + host + ":" + std::to_string(port);
+}
+
+const std::string &HttpPool::accept_encoding()
+{
+    static const std::string encodings = []
+    {
+        std::string value;
+#ifdef CPPHTTPLIB_BROTLI_SUPPORT
+        value = "br";
+#endif
+#ifdef CPPHTTPLIB_ZLIB_SUPPORT
+        if (!value.empty())
+            value += ", ";
+        value += "gzip, deflate";
+#endif
+        return value.empty() ? std::string("identity") : value;
+    }();
+    return encodings;
+}
+
+HttpPool::Lease::Lease(HttpPool *pool, std::string origin, std::unique_ptr<httplib::Client> client)
+    : pool_(pool), origin_(std::move(origin)), client_(std::move(client))
+{
+}
+
+HttpPool::Lease::Lease(Lease &&other) noexcept
+    : pool_(other.pool_), origin_(std::move(other.origin_)),
+      client_(std::move(other.client_)), discard_(other.discard_)
+{
+    other.pool_ = nullptr;
+}
+
+HttpPool::Lease &HttpPool::Lease::operator=(Lease &&other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        pool_ = other.pool_;
+        origin_ = std::move(other.origin_);
+        client_ = std::move(other.client_);
+        discard_ = other.discard_;
+        other.pool_ = nullptr;
+    }
+    return *this;
+}
+
+HttpPool::Lease::~Lease()
+{
+    release();
+}
+
+void HttpPool::Lease::discard()
+{
+    discard_ = true;
+}
+
+void HttpPool::Lease::release()
+{
+    if (pool_ && client_)
+    {
+        pool_->give_back(origin_, std::move(client_), discard_);
+    }
+    pool_ = nullptr;
+    client_.reset();
+}
+
+HttpPool &HttpPool::instance()
+{
+    static HttpPool pool;
+    return pool;
+}
+
+HttpPool::HttpPool() : max_per_origin_(kDefaultMaxPerOrigin)
+{
+}
+
+HttpPool::Url HttpPool::parse_url(const std::string &url)
+{
+    size_t protocol_pos = url.find("://");
+    if (protocol_pos == std::string::npos)
+    {
+        throw std::runtime_error("Invalid URL format");
+    }
+
+    Url parts;
+    parts.protocol = url.substr(0, protocol_pos);
+    std::string host_port_path = url.substr(protocol_pos + 3);
+
+    size_t slash_pos = host_port_path.find('/');
+    std::string host_port = host_port_path.substr(0, slash_pos);
+    parts.path = slash_pos == std::string::npos ? "/" : host_port_path.substr(slash_pos);
+
+    size_t colon_pos = host_port.find(':');
+    if (colon_pos != std::string::npos)
+    {
+        parts.host = host_port.substr(0, colon_pos);
+        parts.port = std::stoi(host_port.substr(colon_pos + 1));
+    }
+    else
+    {
+        parts.host = host_port;
+        parts.port = (parts.protocol == "https") ? 443 : 80;
+    }
+    return parts;
+}
+
+void HttpPool::set_max_per_origin(size_t max_connections)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_per_origin_ = std::max<size_t>(1, max_connections);
+    cv_.notify_all();
+}
+
+HttpPool::Lease HttpPool::acquire(const Url &url, int read_timeout)
+{
+    const std::string origin = url.origin();
+    std::unique_ptr<httplib::Client> client;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        Origin &entry = origins_[origin];
+        cv_.wait(lock, [&]
+                 { return entry.in_use < max_per_origin_; });
+        entry.in_use++;
+
+        auto now = std::chrono::steady_clock::now();
+        while (!entry.idle.empty() && !client)
+        {
+            auto &last = entry.idle.back();
+            if (now - last.second < kIdleTimeout)
+                client = std::move(last.first);
+            entry.idle.pop_back();
+        }
+    }
+
+    if (!client)
+    {
+        // 带协议构造，https 源站走 SSLClient
+        client.reset(new httplib::Client(origin));
+        client->set_connection_timeout(10);
+        client->set_write_timeout(10);
+        client->set_keep_alive(true);
+        client->set_decompress(true);
+        if (url.protocol == "https")
+        {
+            client->enable_server_certificate_verification(false);
+        }
+
+        std::string address = resolve(url.host);
+        if (!address.empty())
+        {
+            client->set_hostname_addr_map({{url.host, address}});
+        }
+    }
+    client->set_read_timeout(read_timeout);
+    return Lease(this, origin, std::move(client));
+}
+
+void HttpPool::give_back(const std::string &origin, std::unique_ptr<httplib::Client> client, bool discard)
+{
+    std::unique_ptr<httplib::Client> closing;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Origin &entry = origins_[origin];
+        entry.in_use--;
+        if (discard)
+        {
+            // 连接出错时主机地址可能已变化，下次重新解析
+            closing = std::move(client);
+            dns_.erase(closing->host());
+        }
+        else
+        {
+            entry.idle.emplace_back(std::move(client), std::chrono::steady_clock::now());
+        }
+    }
+    // 所有源站共用一个条件变量，等待者的条件各不相同，需全部唤醒
+    cv_.notify_all();
+}
+
+std::string HttpPool::resolve(const std::string &host)
+{
+    // 本身就是IP地址
+    unsigned char buf[sizeof(struct in6_addr)];
+    if (inet_pton(AF_INET, host.c_str(), buf) == 1 || inet_pton(AF_INET6, host.c_str(), buf) == 1)
+    {
+        return "";
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = dns_.find(host);
+        if (it != dns_.end() && std::chrono::steady_clock::now() < it->second.expires)
+        {
+            return it->second.address;
+        }
+    }
+
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *result = nullptr;
+    if (getaddrinfo(host.c_str(), nullptr, &hints, &result) != 0 || !result)
+    {
+        LOGW("HttpPool", "域名解析失败:%s", host.c_str());
+        return "";
+    }
+
+    char address[INET6_ADDRSTRLEN] = {0};
+    if (result->ai_family == AF_INET)
+    {
+        inet_ntop(AF_INET, &reinterpret_cast<struct sockaddr_in *>(result->ai_addr)->sin_addr, address, sizeof(address));
+    }
+    else if (result->ai_family == AF_INET6)
+    {
+        inet_ntop(AF_INET6, &reinterpret_cast<struct sockaddr_in6 *>(result->ai_addr)->sin6_addr, address, sizeof(address));
+    }
+    freeaddrinfo(result);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    dns_[host] = {address, std::chrono::steady_clock::now() + kDnsTtl};
+    return address;
+}
@@ -3,6 +3,7 @@
 #include <json/json.h>
 #include <sstream>
 #include "Tools.h"
+#include "content_codec.h"
 #include <cctype>
 #include <iomanip>
 #include <string>
@@ -64,6 +65,21 @@ int mqtt_client::messageArrived(void *context, char *topicName, int topicLen, MQ
         {
             std::string code = payload.substr(0, 4);
             std::string body = payload.substr(4);
+            // 压缩的消息：编码 + "#" + 压缩格式 + "#" + 压缩后的内容，如 0002#gzip#...
+            size_t flag_end;
+            if (body.size() > 1 && body[0] == '#' && (flag_end = body.find('#', 1)) != std::string::npos)
+            {
+                std::string encoding = body.substr(1, flag_end - 1);
+                std::string decoded;
+                if (!ContentCodec::decompress(encoding, body.substr(flag_end + 1), decoded))
+                {
+                    LOGE("Display", "消息解压失败 Code:%s 格式:%s", code.c_str(), encoding.c_str());
+                    MQTTClient_free(topicName);
+                    MQTTClient_freeMessage(&message);
+                    return 1;
+                }
+                body.swap(decoded);
+            }
             self->message_callback_(code, body);
         }
     }
@@ -75,7 +91,23 @@ int mqtt_client::messageArrived(void *context, char *topicName, int topicLen, MQ
 
 void mqtt_client::deliveryComplete(void *context, MQTTClient_deliveryToken dt)
 {
-    // 消息发布完成回调
+    // 消息发布完成回调，用于测量往返时延
+    mqtt_client *self = static_cast<mqtt_client *>(context);
+    int rtt_ms;
+    {
+        std::lock_guard<std::mutex> lock(self->in_flight_mutex_);
+        auto it = self->in_flight_.find(dt);
+        if (it == self->in_flight_.end())
+            return;
+        rtt_ms = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                      std::chrono::steady_clock::now() - it->second)
+                                      .count());
+        self->in_flight_.erase(it);
+    }
+    if (self->rtt_callback_)
+    {
+        self->rtt_callback_(rtt_ms);
+    }
 }
 
 void mqtt_client::disconnect()
@@ -91,6 +123,11 @@ void mqtt_client::setMessageCallback(MessageCallback callback)
     message_callback_ = callback;
 }
 
+void mqtt_client::setRttCallback(RttCallback callback)
+{
+    rtt_callback_ = callback;
+}
+
 void mqtt_client::publish(const std::string &command,
                           const std::string &message,
                           int qos)
@@ -108,10 +145,24 @@ void mqtt_client::publish(const std::string &command,
     pubmsg.retained = 0;
 
     MQTTClient_deliveryToken token;
+    // 发布时不持锁：在途窗口满时 Paho 会等待接收线程，而确认回调需要同一把锁。
+    // 确认先于登记到达时这一条不计入时延，留下的登记由下面的过期清理删除
+    auto now = std::chrono::steady_clock::now();
     int rc = MQTTClient_publishMessage(client_, topic.c_str(), &pubmsg, &token);
     if (rc != MQTTCLIENT_SUCCESS)
     {
         LOGE("Display", "Publish error: %d", rc);
+        return;
+    }
+    if (qos > 0)
+    {
+        std::lock_guard<std::mutex> lock(in_flight_mutex_);
+        // 断线后不会再确认的消息
+        for (auto it = in_flight_.begin(); it != in_flight_.end();)
+        {
+            it = now - it->second > std::chrono::minutes(1) ? in_flight_.erase(it) : std::next(it);
+        }
+        in_flight_[token] = now;
     }
 }
 
@@ -0,0 +1,647 @@
+#include "multicast_push.h"
+#include "file_digest.h"
+#include "atomic_file.h"
+#include <random>
+#include <algorithm>
+#include <filesystem>
+#include <cstring>
+#include <cctype>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <logger.h>
+
+namespace
+{
+    // 与局域网共享相同的链路本地组播组，使用单独的端口
+    constexpr const char *kGroup = "224.0.0.10";
+    constexpr int kPushPort = 9005;
+
+    constexpr uint8_t kTypeData = 1;
+    constexpr uint8_t kTypeParity = 2;
+    constexpr uint8_t kTypeEnd = 3;
+
+    constexpr size_t kNameSize = 48;
+    constexpr size_t kHeaderSize = 4 + 1 + 1 + 2 + 4 + 8 + 4 + 2 + kNameSize;
+    // 报文不超过以太网 MTU，避免 IP 分片（一片丢失整个报文作废）
+    constexpr size_t kChunkSize = 1380;
+    constexpr uint32_t kGroupSize = 16;
+    // 每个 NACK 报文最多携带的块号
+    constexpr size_t kMaxNackIds = 348;
+
+    // 默认约 32Mbit/s，不占满门店无线网络
+    constexpr uint64_t kDefaultRate = 4 * 1024 * 1024;
+    // 每轮结束后等待 NACK 的时间
+    constexpr std::chrono::seconds kRepairWait(1);
+    constexpr uint32_t kMaxRounds = 20;
+    // 结束报文重复发送，降低丢失后整轮无人报告缺失的概率
+    constexpr int kEndRepeats = 3;
+    constexpr int kNackDelayMaxMs = 200;
+    // 发送端长时间没有报文，放弃接收
+    constexpr std::chrono::seconds kIdleTimeout(60);
+
+    struct Header
+    {
+        uint8_t type = 0;
+        uint16_t length = 0;
+        uint32_t session = 0;
+        uint64_t size = 0;
+        uint32_t index = 0;
+        uint16_t nack_port = 0;
+        std::string name;
+    };
+
+    void put_be(std::string &out, uint64_t value, int bytes)
+    {
+        for (int i = bytes - 1; i >= 0; --i)
+        {
+            out += static_cast<char>((value >> (i * 8)) & 0xff);
+        }
+    }
+
+    uint64_t get_be(const uint8_t *p, int bytes)
+    {
+        uint64_t value = 0;
+        for (int i = 0; i < bytes; ++i)
+        {
+            value = (value << 8) | p[i];
+        }
+        return value;
+    }
+
+    std::string encode(const Header &h, const char *payload, size_t len)
+    {
+        std::string out("EPMP");
+        out.reserve(kHeaderSize + len);
+        put_be(out, h.type, 1);
+        put_be(out, 0, 1);
+        put_be(out, len, 2);
+        put_be(out, h.session, 4);
+        put_be(out, h.size, 8);
+        put_be(out, h.index, 4);
+        put_be(out, h.nack_port, 2);
+        std::string name = h.name;
+        name.resize(kNameSize, '\0');
+        out += name;
+        out.append(payload, len);
+        return out;
+    }
+
+    bool decode(const uint8_t *data, size_t len, Header &h)
+    {
+        if (len < kHeaderSize || memcmp(data, "EPMP", 4) != 0)
+            return false;
+        h.type = data[4];
+        h.length = static_cast<uint16_t>(get_be(data + 6, 2));
+        h.session = static_cast<uint32_t>(get_be(data + 8, 4));
+        h.size = get_be(data + 12, 8);
+        h.index = static_cast<uint32_t>(get_be(data + 20, 4));
+        h.nack_port = static_cast<uint16_t>(get_be(data + 24, 2));
+        const char *name = reinterpret_cast<const char *>(data + 26);
+        h.name.assign(name, strnlen(name, kNameSize));
+        return kHeaderSize + h.length == len;
+    }
+}
+
+MulticastPush::MulticastPush(const std::string &dir, WantCheck want, ReceivedHandler on_received)
+    : dir_(dir), want_(std::move(want)), on_received_(std::move(on_received)), socket_fd_(-1), rng_(std::random_device{}()), stop_(false)
+{
+    socket_fd_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (socket_fd_ != -1)
+    {
+        int optval = 1;
+        setsockopt(socket_fd_, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
+        // 写盘偶尔变慢时由接收缓冲吸收突发，减少丢包
+        int rcvbuf = 4 * 1024 * 1024;
+        setsockopt(socket_fd_, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+        timeval timeout{0, 100 * 1000};
+        setsockopt(socket_fd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(kPushPort);
+
+        ip_mreq mreq;
+        mreq.imr_multiaddr.s_addr = inet_addr(kGroup);
+        mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+        if (bind(socket_fd_, (sockaddr *)&addr, sizeof(addr)) == -1 ||
+            setsockopt(socket_fd_, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) == -1)
+        {
+            LOGW("MulticastPush", "加入组播组失败 %s", strerror(errno));
+            ::close(socket_fd_);
+            socket_fd_ = -1;
+        }
+    }
+    if (socket_fd_ != -1)
+    {
+        receive_thread_ = std::thread(&MulticastPush::receive_loop, this);
+        verify_thread_ = std::thread(&MulticastPush::verify_loop, this);
+    }
+    send_thread_ = std::thread(&MulticastPush::send_loop, this);
+}
+
+MulticastPush::~MulticastPush()
+{
+    stop_ = true;
+    send_cv_.notify_all();
+    verify_cv_.notify_all();
+    for (std::thread *t : {&receive_thread_, &send_thread_, &verify_thread_})
+    {
+        if (t->joinable())
+            t->join();
+    }
+    for (auto &entry : incoming_)
+    {
+        abandon(entry.second);
+    }
+    std::error_code ec;
+    for (const auto &file : received_)
+    {
+        std::filesystem::remove(dir_ + file.name + ".mcast.part", ec);
+    }
+    if (socket_fd_ != -1)
+    {
+        ::close(socket_fd_);
+    }
+}
+
+void MulticastPush::push(const std::string &name, uint64_t rate)
+{
+    {
+        std::lock_guard<std::mutex> lock(send_mutex_);
+        outgoing_.push_back({name, rate ? rate : kDefaultRate});
+    }
+    send_cv_.notify_all();
+}
+
+void MulticastPush::send_loop()
+{
+    while (true)
+    {
+        Outgoing job;
+        {
+            std::unique_lock<std::mutex> lock(send_mutex_);
+            send_cv_.wait(lock, [this]
+                          { return stop_ || !outgoing_.empty(); });
+            if (stop_)
+                return;
+            job = outgoing_.front();
+            outgoing_.pop_front();
+        }
+        send_file(job);
+    }
+}
+
+bool MulticastPush::send_file(const Outgoing &job)
+{
+    const std::string path = dir_ + job.name;
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) != 0 || st.st_size <= 0 || !valid_name(job.name))
+    {
+        LOGW("MulticastPush", "无法推送 %s", path.c_str());
+        if (fd != -1)
+            ::close(fd);
+        return false;
+    }
+
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock == -1)
+    {
+        ::close(fd);
+        return false;
+    }
+    unsigned char ttl = 1;
+    setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    timeval timeout{0, 100 * 1000};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    // NACK 发到本套接字的临时端口
+    sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    socklen_t local_len = sizeof(local);
+    if (bind(sock, (sockaddr *)&local, sizeof(local)) == -1 ||
+        getsockname(sock, (sockaddr *)&local, &local_len) == -1)
+    {
+        ::close(sock);
+        ::close(fd);
+        return false;
+    }
+
+    sockaddr_in group;
+    memset(&group, 0, sizeof(group));
+    group.sin_family = AF_INET;
+    group.sin_addr.s_addr = inet_addr(kGroup);
+    group.sin_port = htons(kPushPort);
+
+    std::random_device device;
+    Header header;
+    header.session = std::uniform_int_distribution<uint32_t>(1, UINT32_MAX)(device);
+    header.size = static_cast<uint64_t>(st.st_size);
+    header.nack_port = ntohs(local.sin_port);
+    header.name = job.name;
+    const uint32_t chunks = static_cast<uint32_t>((header.size + kChunkSize - 1) / kChunkSize);
+
+    // 按目标速率均匀发送，不产生突发
+    const auto start = std::chrono::steady_clock::now();
+    uint64_t sent_bytes = 0;
+    auto send_packet = [&](uint8_t type, uint32_t index, const char *payload, size_t len)
+    {
+        header.type = type;
+        header.index = index;
+        const std::string packet = encode(header, payload, len);
+        std::this_thread::sleep_until(start + std::chrono::microseconds(sent_bytes * 1000000 / job.rate));
+        sendto(sock, packet.data(), packet.size(), 0, (const sockaddr *)&group, sizeof(group));
+        sent_bytes += packet.size();
+    };
+    auto read_chunk = [&](uint32_t index, char *buf) -> size_t
+    {
+        const uint64_t offset = static_cast<uint64_t>(index) * kChunkSize;
+        const size_t len = static_cast<size_t>(std::min<uint64_t>(kChunkSize, header.size - offset));
+        return pread(fd, buf, len, offset) == static_cast<ssize_t>(len) ? len : 0;
+    };
+
+    LOGI("MulticastPush", "组播推送 %s 大小:%llu 块数:%u", job.name.c_str(), (unsigned long long)header.size, chunks);
+    char buf[kChunkSize];
+    char parity[kChunkSize];
+    bool ok = true;
+    memset(parity, 0, sizeof(parity));
+    for (uint32_t i = 0; i < chunks && !stop_; ++i)
+    {
+        size_t len = read_chunk(i, buf);
+        if (len == 0)
+        {
+            ok = false;
+            break;
+        }
+        for (size_t k = 0; k < len; ++k)
+        {
+            parity[k] ^= buf[k];
+        }
+        send_packet(kTypeData, i, buf, len);
+        if (i % kGroupSize == kGroupSize - 1 || i == chunks - 1)
+        {
+            send_packet(kTypeParity, i / kGroupSize, parity, kChunkSize);
+            memset(parity, 0, sizeof(parity));
+        }
+    }
+
+    uint32_t round = 0;
+    while (ok && !stop_)
+    {
+        for (int i = 0; i < kEndRepeats; ++i)
+        {
+            send_packet(kTypeEnd, round, nullptr, 0);
+        }
+
+        // 汇总所有接收端缺失的块，同一块只重发一次
+        std::set<uint32_t> missing;
+        uint8_t nack[2048];
+        auto deadline = std::chrono::steady_clock::now() + kRepairWait;
+        while (std::chrono::steady_clock::now() < deadline && !stop_)
+        {
+            ssize_t n = recv(sock, nack, sizeof(nack), 0);
+            if (n < 8 || memcmp(nack, "EPMN", 4) != 0 || get_be(nack + 4, 4) != header.session)
+                continue;
+            for (ssize_t off = 8; off + 4 <= n; off += 4)
+            {
+                uint32_t index = static_cast<uint32_t>(get_be(nack + off, 4));
+                if (index < chunks)
+                    missing.insert(index);
+            }
+        }
+        if (missing.empty())
+            break;
+        if (++round >= kMaxRounds)
+        {
+            LOGW("MulticastPush", "组播推送 %s 重传 %u 轮后仍有缺失，剩余由接收端回源下载", job.name.c_str(), round);
+            break;
+        }
+        LOGI("MulticastPush", "第 %u 轮重传 %zu 块", round, missing.size());
+        for (uint32_t index : missing)
+        {
+            size_t len = read_chunk(index, buf);
+            if (len == 0 || stop_)
+            {
+                ok = false;
+                break;
+            }
+            send_packet(kTypeData, index, buf, len);
+        }
+    }
+
+    ::close(sock);
+    ::close(fd);
+    if (ok && !stop_)
+    {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        LOGI("MulticastPush", "组播推送完成 %s 发送:%llu 耗时:%.1fs", job.name.c_str(), (unsigned long long)sent_bytes, seconds);
+    }
+    return ok;
+}
+
+void MulticastPush::receive_loop()
+{
+    std::vector<uint8_t> buffer(kHeaderSize + kChunkSize + 64);
+    while (!stop_)
+    {
+        sockaddr_in sender;
+        socklen_t sender_len = sizeof(sender);
+        ssize_t n = recvfrom(socket_fd_, buffer.data(), buffer.size(), 0, (sockaddr *)&sender, &sender_len);
+        if (n > 0)
+        {
+            handle_packet(buffer.data(), static_cast<size_t>(n), inet_ntoa(sender.sin_addr));
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        for (auto it = incoming_.begin(); it != incoming_.end();)
+        {
+            Incoming &in = it->second;
+            if (now - in.last_packet > kIdleTimeout)
+            {
+                LOGW("MulticastPush", "组播推送中断 %s 已接收 %u/%u", in.name.c_str(), in.received, in.chunks);
+                abandon(in);
+                finished_.insert(it->first);
+                it = incoming_.erase(it);
+                continue;
+            }
+            if (in.nack_pending && now >= in.nack_due)
+            {
+                in.nack_pending = false;
+                send_nack(it->first, in);
+            }
+            ++it;
+        }
+    }
+}
+
+void MulticastPush::handle_packet(const uint8_t *data, size_t len, const std::string &sender)
+{
+    Header h;
+    if (!decode(data, len, h) || finished_.count(h.session))
+        return;
+    const uint8_t *payload = data + kHeaderSize;
+
+    auto it = incoming_.find(h.session);
+    if (it == incoming_.end())
+    {
+        bool verifying;
+        {
+            std::lock_guard<std::mutex> lock(verify_mutex_);
+            verifying = verifying_.count(h.name) > 0;
+        }
+        if (h.size == 0 || !valid_name(h.name) || verifying || !want_(h.name))
+        {
+            finished_.insert(h.session);
+            return;
+        }
+        std::error_code ec;
+        auto space = std::filesystem::space(dir_, ec);
+        if (ec || space.available < h.size)
+        {
+            LOGW("MulticastPush", "磁盘空间不足，忽略组播推送 %s", h.name.c_str());
+            finished_.insert(h.session);
+            return;
+        }
+
+        // 与普通下载的 .part 区分，两者可能同时进行
+        const std::string part_path = dir_ + h.name + ".mcast.part";
+        int fd = ::open(part_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd == -1)
+        {
+            finished_.insert(h.session);
+            return;
+        }
+        Incoming &in = incoming_[h.session];
+        in.name = h.name;
+        in.size = h.size;
+        in.chunks = static_cast<uint32_t>((h.size + kChunkSize - 1) / kChunkSize);
+        in.have.assign(in.chunks, false);
+        in.fd = fd;
+        it = incoming_.find(h.session);
+        LOGI("MulticastPush", "接收组播推送 %s 来自:%s 大小:%llu", h.name.c_str(), sender.c_str(), (unsigned long long)h.size);
+    }
+
+    Incoming &in = it->second;
+    in.sender = sender;
+    in.nack_port = h.nack_port;
+    in.last_packet = std::chrono::steady_clock::now();
+
+    switch (h.type)
+    {
+    case kTypeData:
+        if (h.index < in.chunks && h.length == chunk_length(in, h.index))
+        {
+            store_chunk(in, h.index, payload, h.length);
+            try_recover(in, h.index / kGroupSize);
+        }
+        break;
+    case kTypeParity:
+        if (h.index <= (in.chunks - 1) / kGroupSize && h.length == kChunkSize)
+        {
+            in.parity[h.index].assign(reinterpret_cast<const char *>(payload), h.length);
+            try_recover(in, h.index);
+        }
+        break;
+    case kTypeEnd:
+        if (in.received < in.chunks && in.nacked_round != h.index)
+        {
+            in.nacked_round = h.index;
+            in.nack_pending = true;
+            in.nack_due = in.last_packet + std::chrono::milliseconds(rng_() % (kNackDelayMaxMs + 1));
+        }
+        break;
+    }
+
+    if (in.received == in.chunks)
+    {
+        finish(h.session, in);
+        finished_.insert(h.session);
+        incoming_.erase(h.session);
+    }
+}
+
+void MulticastPush::store_chunk(Incoming &in, uint32_t index, const uint8_t *data, size_t len)
+{
+    if (in.have[index])
+        return;
+    const off_t offset = static_cast<off_t>(index) * kChunkSize;
+    if (pwrite(in.fd, data, len, offset) != static_cast<ssize_t>(len))
+    {
+        // 写入失败的块留待 NACK 重传
+        return;
+    }
+    in.have[index] = true;
+    in.received++;
+}
+
+void MulticastPush::try_recover(Incoming &in, uint32_t group)
+{
+    const uint32_t first = group * kGroupSize;
+    const uint32_t last = std::min(first + kGroupSize, in.chunks);
+    uint32_t missing = 0;
+    uint32_t missing_index = 0;
+    for (uint32_t i = first; i < last; ++i)
+    {
+        if (!in.have[i])
+        {
+            missing++;
+            missing_index = i;
+        }
+    }
+    auto parity = in.parity.find(group);
+    if (missing == 0)
+    {
+        if (parity != in.parity.end())
+            in.parity.erase(parity);
+        return;
+    }
+    if (missing > 1 || parity == in.parity.end())
+        return;
+
+    // 组内其余块与校验块异或得到丢失的块，末块不足的部分按 0 参与
+    std::string chunk = parity->second;
+    char buf[kChunkSize];
+    for (uint32_t i = first; i < last; ++i)
+    {
+        if (i == missing_index)
+            continue;
+        const size_t len = chunk_length(in, i);
+        if (pread(in.fd, buf, len, static_cast<off_t>(i) * kChunkSize) != static_cast<ssize_t>(len))
+            return;
+        for (size_t k = 0; k < len; ++k)
+        {
+            chunk[k] ^= buf[k];
+        }
+    }
+    store_chunk(in, missing_index, reinterpret_cast<const uint8_t *>(chunk.data()), chunk_length(in, missing_index));
+    in.parity.erase(group);
+}
+
+void MulticastPush::finish(uint32_t session, Incoming &in)
+{
+    ::close(in.fd);
+    in.fd = -1;
+    {
+        std::lock_guard<std::mutex> lock(verify_mutex_);
+        received_.push_back({session, in.name});
+        verifying_.insert(in.name);
+    }
+    verify_cv_.notify_all();
+}
+
+void MulticastPush::verify_loop()
+{
+    while (true)
+    {
+        Received file;
+        {
+            std::unique_lock<std::mutex> lock(verify_mutex_);
+            verify_cv_.wait(lock, [this]
+                            { return stop_ || !received_.empty(); });
+            if (stop_)
+                return;
+            file = received_.front();
+            received_.pop_front();
+        }
+        verify(file);
+        std::lock_guard<std::mutex> lock(verify_mutex_);
+        verifying_.erase(file.name);
+    }
+}
+
+void MulticastPush::verify(const Received &file)
+{
+    const std::string part_path = dir_ + file.name + ".mcast.part";
+    const std::string local_path = dir_ + file.name;
+
+    // 文件名即 MD5
+    const std::string md5 = Md5Digest::file_md5(part_path, nullptr, &stop_);
+    if (stop_)
+    {
+        std::error_code ec;
+        std::filesystem::remove(part_path, ec);
+        return;
+    }
+    if (md5 != file.name.substr(0, 32))
+    {
+        LOGW("MulticastPush", "组播推送 %s MD5验证不通过:%s", file.name.c_str(), md5.c_str());
+        std::filesystem::remove(part_path);
+        return;
+    }
+    if (!AtomicFile::publish(part_path, local_path))
+    {
+        LOGW("MulticastPush", "发布文件失败 %s %s", local_path.c_str(), strerror(errno));
+        std::filesystem::remove(part_path);
+        return;
+    }
+    LOGI("MulticastPush", "组播推送接收完成 %s 会话:%u", file.name.c_str(), file.session);
+    on_received_(file.name, md5);
+}
+
+void MulticastPush::send_nack(uint32_t session, Incoming &in)
+{
+    sockaddr_in dest;
+    memset(&dest, 0, sizeof(dest));
+    dest.sin_family = AF_INET;
+    dest.sin_addr.s_addr = inet_addr(in.sender.c_str());
+    dest.sin_port = htons(in.nack_port);
+
+    std::string packet;
+    auto flush = [&]()
+    {
+        if (packet.size() > 8)
+            sendto(socket_fd_, packet.data(), packet.size(), 0, (const sockaddr *)&dest, sizeof(dest));
+        packet.assign("EPMN");
+        put_be(packet, session, 4);
+    };
+    flush();
+    for (uint32_t i = 0; i < in.chunks; ++i)
+    {
+        if (in.have[i])
+            continue;
+        put_be(packet, i, 4);
+        if (packet.size() >= 8 + kMaxNackIds * 4)
+            flush();
+    }
+    flush();
+}
+
+void MulticastPush::abandon(Incoming &in)
+{
+    if (in.fd != -1)
+    {
+        ::close(in.fd);
+        in.fd = -1;
+    }
+    std::error_code ec;
+    std::filesystem::remove(dir_ + in.name + ".mcast.part", ec);
+}
+
+size_t MulticastPush::chunk_length(const Incoming &in, uint32_t index) const
+{
+    const uint64_t offset = static_cast<uint64_t>(index) * kChunkSize;
+    return static_cast<size_t>(std::min<uint64_t>(kChunkSize, in.size - offset));
+}
+
+bool MulticastPush::valid_name(const std::string &name)
+{
+    // 只接受 <MD5><扩展名> 形式的文件名
+    if (name.size() < 32 || name.size() > kNameSize || name.find("..") != std::string::npos)
+        return false;
+    for (size_t i = 0; i < name.size(); ++i)
+    {
+        const char c = name[i];
+        const bool hex = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
+        if (i < 32 ? !hex : !(std::isalnum(static_cast<unsigned char>(c)) || c == '.' || c == '_' || c == '-'))
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,97 @@
+#include "origin_selector.h"
+#include "http_pool.h"
+#include <algorithm>
+
+namespace
+{
+    constexpr double kSmoothing = 0.3;
+    // 未测量的源站按中等网络估计，测量过的更好或更差的源站会自然排开
+    constexpr double kDefaultLatencyMs = 300;
+    constexpr double kDefaultBytesPerSec = 1024 * 1024;
+    constexpr uint64_t kMinTransferSample = 1024 * 1024;
+    // 每次连续失败使预计时间翻倍
+    constexpr int kMaxFailurePenalty = 6;
+    // 同一组源站重新竞速的间隔
+    constexpr std::chrono::minutes kRaceInterval(10);
+
+    double smooth(double current, double sample)
+    {
+        return current < 0 ? sample : current + kSmoothing * (sample - current);
+    }
+}
+
+void OriginSelector::report_latency(const std::string &origin, double latency_ms)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats &stats = stats_[origin];
+    stats.latency_ms = smooth(stats.latency_ms, latency_ms);
+}
+
+void OriginSelector::report_transfer(const std::string &origin, uint64_t bytes, double seconds)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats &stats = stats_[origin];
+    stats.failures = 0;
+    if (bytes >= kMinTransferSample && seconds > 0)
+    {
+        stats.bytes_per_sec = smooth(stats.bytes_per_sec, bytes / seconds);
+    }
+}
+
+void OriginSelector::report_failure(const std::string &origin)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats &stats = stats_[origin];
+    stats.failures = std::min(stats.failures + 1, kMaxFailurePenalty);
+}
+
+void OriginSelector::rank(std::vector<std::string> &urls, uint64_t expected_bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::pair<double, std::string>> scored;
+    for (const auto &url : urls)
+    {
+        scored.emplace_back(estimate_locked(HttpPool::parse_url(url).origin(), expected_bytes), url);
+    }
+    std::stable_sort(scored.begin(), scored.end(), [](const auto &a, const auto &b)
+                     { return a.first < b.first; });
+    for (size_t i = 0; i < urls.size(); ++i)
+    {
+        urls[i] = scored[i].second;
+    }
+}
+
+bool OriginSelector::begin_race(std::vector<std::string> origins)
+{
+    std::sort(origins.begin(), origins.end());
+    std::string key;
+    for (const auto &origin : origins)
+    {
+        key += origin + ",";
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = races_.find(key);
+    if (it != races_.end() && now - it->second < kRaceInterval)
+        return false;
+    races_[key] = now;
+    return true;
+}
+
+double OriginSelector::estimate_locked(const std::string &origin, uint64_t bytes) const
+{
+    double latency = kDefaultLatencyMs;
+    double throughput = kDefaultBytesPerSec;
+    int failures = 0;
+    auto it = stats_.find(origin);
+    if (it != stats_.end())
+    {
+        if (it->second.latency_ms >= 0)
+            latency = it->second.latency_ms;
+        if (it->second.bytes_per_sec > 0)
+            throughput = it->second.bytes_per_sec;
+        failures = it->second.failures;
+    }
+    return (latency + bytes * 1000.0 / throughput) * (1 << failures);
+}
@@ -0,0 +1,290 @@
+#include "peer_cache.h"
+#include <random>
+#include <algorithm>
+#include <cstring>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <json/json.h>
+#include <logger.h>
+
+namespace
+{
+    // 与管理工具相同的链路本地组播组，使用单独的端口
+    constexpr const char *kGroup = "224.0.0.10";
+    constexpr int kDiscoveryPort = 9003;
+    constexpr std::chrono::seconds kAnnounceInterval(30);
+    // 连续三次没有收到通告视为已离线
+    constexpr std::chrono::seconds kPeerTimeout(100);
+    // 布隆过滤器 4096 位、4 个哈希，数百个文件时误判率低于 1%
+    constexpr size_t kBloomBytes = 512;
+    constexpr int kBloomHashes = 4;
+    // 每个文件最多尝试的播放器数
+    constexpr size_t kMaxCandidates = 2;
+
+    uint64_t fnv1a(const std::string &s, uint64_t seed)
+    {
+        uint64_t hash = 14695981039346656037ULL ^ seed;
+        for (unsigned char c : s)
+        {
+            hash ^= c;
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    size_t bloom_bit(const std::string &name, int i)
+    {
+        const uint64_t h1 = fnv1a(name, 0);
+        const uint64_t h2 = fnv1a(name, 0x9e3779b97f4a7c15ULL) | 1;
+        return static_cast<size_t>((h1 + i * h2) % (kBloomBytes * 8));
+    }
+
+    std::string to_hex(const std::vector<uint8_t> &data)
+    {
+        static const char digits[] = "0123456789abcdef";
+        std::string out;
+        out.reserve(data.size() * 2);
+        for (uint8_t b : data)
+        {
+            out += digits[b >> 4];
+            out += digits[b & 0x0f];
+        }
+        return out;
+    }
+
+    bool from_hex(const std::string &hex, std::vector<uint8_t> &out)
+    {
+        if (hex.size() % 2 != 0)
+            return false;
+        out.resize(hex.size() / 2);
+        for (size_t i = 0; i < out.size(); ++i)
+        {
+            char byte[3] = {hex[i * 2], hex[i * 2 + 1], 0};
+            char *end;
+            out[i] = static_cast<uint8_t>(std::strtoul(byte, &end, 16));
+            if (*end != 0)
+                return false;
+        }
+        return true;
+    }
+}
+
+PeerCache::PeerCache(const std::string &dir, ListHandler list, ServeCheck can_serve, int port)
+    : dir_(dir), list_(std::move(list)), can_serve_(std::move(can_serve)), port_(port),
+      serving_(false), socket_fd_(-1), stop_(false), announce_now_(false)
+{
+    std::random_device device;
+    std::mt19937_64 rng(device());
+    instance_id_ = std::to_string(rng());
+
+    // 只提供校验过的资源文件；由 httplib 映射文件发送，支持 Range
+    server_.Get(R"(/assets/([0-9A-Za-z._-]+))", [this](const httplib::Request &req, httplib::Response &res)
+                {
+                    const std::string name = req.matches[1];
+                    if (!valid_name(name) || !can_serve_(name))
+                    {
+                        res.status = 404;
+                        return;
+                    }
+                    res.set_file_content(dir_ + name, "application/octet-stream"); });
+
+    serving_ = server_.bind_to_port("0.0.0.0", port_);
+    if (serving_)
+    {
+        server_thread_ = std::thread([this]
+                                     { server_.listen_after_bind(); });
+        announce_thread_ = std::thread(&PeerCache::announce_loop, this);
+    }
+    else
+    {
+        LOGW("PeerCache", "共享服务端口 %d 绑定失败，只从其他播放器获取", port_);
+    }
+
+    socket_fd_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (socket_fd_ != -1)
+    {
+        int optval = 1;
+        setsockopt(socket_fd_, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
+        timeval timeout{1, 0};
+        setsockopt(socket_fd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(kDiscoveryPort);
+
+        ip_mreq mreq;
+        mreq.imr_multiaddr.s_addr = inet_addr(kGroup);
+        mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+        if (bind(socket_fd_, (sockaddr *)&addr, sizeof(addr)) == -1 ||
+            setsockopt(socket_fd_, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) == -1)
+        {
+            LOGW("PeerCache", "加入组播组失败 %s", strerror(errno));
+            ::close(socket_fd_);
+            socket_fd_ = -1;
+        }
+    }
+    if (socket_fd_ != -1)
+    {
+        listen_thread_ = std::thread(&PeerCache::listen_loop, this);
+    }
+}
+
+PeerCache::~PeerCache()
+{
+    stop_ = true;
+    if (serving_)
+    {
+        server_.wait_until_ready();
+        server_.stop();
+    }
+    for (std::thread *t : {&server_thread_, &announce_thread_, &listen_thread_})
+    {
+        if (t->joinable())
+            t->join();
+    }
+    if (socket_fd_ != -1)
+    {
+        ::close(socket_fd_);
+    }
+}
+
+std::vector<std::string> PeerCache::locate(const std::string &name)
+{
+    std::vector<const Peer *> candidates;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto now = std::chrono::steady_clock::now();
+    for (auto it = peers_.begin(); it != peers_.end();)
+    {
+        if (now - it->second.last_seen > kPeerTimeout)
+        {
+            it = peers_.erase(it);
+            continue;
+        }
+        if (bloom_contains(it->second.bloom, name))
+        {
+            candidates.push_back(&it->second);
+        }
+        ++it;
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Peer *a, const Peer *b)
+              { return a->last_seen > b->last_seen; });
+
+    std::vector<std::string> urls;
+    for (size_t i = 0; i < candidates.size() && i < kMaxCandidates; ++i)
+    {
+        urls.push_back("http://" + candidates[i]->address + ":" + std::to_string(candidates[i]->port) + "/assets/" + name);
+    }
+    return urls;
+}
+
+void PeerCache::announce_loop()
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (fd == -1)
+        return;
+    // 组播只在本网段内传播
+    unsigned char ttl = 1;
+    setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+
+    sockaddr_in group;
+    memset(&group, 0, sizeof(group));
+    group.sin_family = AF_INET;
+    group.sin_addr.s_addr = inet_addr(kGroup);
+    group.sin_port = htons(kDiscoveryPort);
+
+    while (!stop_)
+    {
+        Json::Value root;
+        root["id"] = instance_id_;
+        root["port"] = port_;
+        root["bloom"] = to_hex(make_bloom(list_()));
+        Json::StreamWriterBuilder wbuilder;
+        wbuilder["indentation"] = "";
+        const std::string message = Json::writeString(wbuilder, root);
+        sendto(fd, message.data(), message.size(), 0, (const sockaddr *)&group, sizeof(group));
+
+        announce_now_ = false;
+        for (auto waited = std::chrono::milliseconds(0); waited < kAnnounceInterval && !stop_ && !announce_now_; waited += std::chrono::milliseconds(200))
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        }
+    }
+    ::close(fd);
+}
+
+void PeerCache::listen_loop()
+{
+    char buffer[2048];
+    while (!stop_)
+    {
+        sockaddr_in sender;
+        socklen_t sender_len = sizeof(sender);
+        ssize_t n = recvfrom(socket_fd_, buffer, sizeof(buffer), 0, (sockaddr *)&sender, &sender_len);
+        if (n <= 0)
+            continue;
+        handle_announcement(std::string(buffer, n), inet_ntoa(sender.sin_addr));
+    }
+}
+
+void PeerCache::handle_announcement(const std::string &message, const std::string &address)
+{
+    Json::Value root;
+    Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    std::string errors;
+    if (!reader->parse(message.data(), message.data() + message.size(), &root, &errors) || !root.isObject())
+        return;
+
+    const std::string id = root["id"].asString();
+    if (id.empty() || id == instance_id_)
+        return;
+
+    Peer peer;
+    peer.address = address;
+    peer.port = root["port"].asInt();
+    if (peer.port <= 0 || !from_hex(root["bloom"].asString(), peer.bloom) || peer.bloom.size() != kBloomBytes)
+        return;
+    peer.last_seen = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!peers_.count(id))
+    {
+        LOGI("PeerCache", "发现局域网播放器 %s:%d", address.c_str(), peer.port);
+        announce_now_ = true;
+    }
+    peers_[id] = std::move(peer);
+}
+
+std::vector<uint8_t> PeerCache::make_bloom(const std::vector<std::string> &names)
+{
+    std::vector<uint8_t> bloom(kBloomBytes, 0);
+    for (const auto &name : names)
+    {
+        for (int i = 0; i < kBloomHashes; ++i)
+        {
+            size_t bit = bloom_bit(name, i);
+            bloom[bit / 8] |= static_cast<uint8_t>(1 << (bit % 8));
+        }
+    }
+    return bloom;
+}
+
+bool PeerCache::bloom_contains(const std::vector<uint8_t> &bloom, const std::string &name)
+{
+    for (int i = 0; i < kBloomHashes; ++i)
+    {
+        size_t bit = bloom_bit(name, i);
+        if (!(bloom[bit / 8] & (1 << (bit % 8))))
+            return false;
+    }
+    return true;
+}
+
+bool PeerCache::valid_name(const std::string &name)
+{
+    return !name.empty() && name[0] != '.' && name.find("..") == std::string::npos;
+}
@@ -0,0 +1,445 @@
+#include "range_downloader.h"
+#include "file_writer.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <unistd.h>
+#include <logger.h>
+
+namespace
+{
+    constexpr int kMinWorkers = 2;
+    constexpr int kMaxWorkers = 6;
+    constexpr uint64_t kInitialChunk = 1024 * 1024;
+    constexpr uint64_t kMinChunk = 256 * 1024;
+    constexpr uint64_t kMaxChunk = 8 * 1024 * 1024;
+    // 分块大小按每块约 2 秒的传输量计算
+    constexpr double kChunkSeconds = 2.0;
+    // 累计失败次数上限，超过后放弃本次下载
+    constexpr int kMaxFailures = 8;
+    // 进度落盘间隔
+    constexpr double kCheckpointSeconds = 2.0;
+}
+
+RangeDownloader::RangeDownloader(ClientFactory factory, const std::string &path, uint64_t file_size)
+    : factory_(std::move(factory)), path_(path), file_size_(file_size), fd_(-1),
+      running_(0), failures_(0), failed_(false), changed_(false), trimmed_(false), cancelled_(nullptr), done_dirty_(false), received_(0)
+{
+}
+
+void RangeDownloader::resume(const Ranges &done, const std::string &etag, const std::string &last_modified)
+{
+    for (const auto &range : done)
+    {
+        if (range.first < range.second && range.second <= file_size_)
+            add_done(range.first, range.second);
+    }
+    done_dirty_ = false;
+    etag_ = etag;
+    last_modified_ = last_modified;
+}
+
+void RangeDownloader::set_worker_limit(std::function<int()> limit)
+{
+    worker_limit_ = std::move(limit);
+}
+
+void RangeDownloader::set_cancel_flag(const std::atomic<bool> *cancelled)
+{
+    cancelled_ = cancelled;
+}
+
+void RangeDownloader::set_throttle(std::function<bool(size_t len)> throttle)
+{
+    throttle_ = std::move(throttle);
+}
+
+int RangeDownloader::worker_limit() const
+{
+    int limit = worker_limit_ ? worker_limit_() : kMaxWorkers;
+    return std::max(1, std::min(limit, kMaxWorkers));
+}
+
+void RangeDownloader::set_checkpoint(Checkpoint checkpoint)
+{
+    checkpoint_ = std::move(checkpoint);
+}
+
+bool RangeDownloader::changed() const
+{
+    return changed_;
+}
+
+bool RangeDownloader::run(int fd, std::string &md5)
+{
+    fd_ = fd;
+    digest_.reset(new OrderedDigest([this](uint64_t offset, char *buf, size_t len)
+                                    { return ::pread(fd_, buf, len, offset) == static_cast<ssize_t>(len); }));
+
+    // 待下载区间为已完成区间的补集，已完成部分从文件读回计入摘要
+    pending_.clear();
+    uint64_t pos = 0;
+    for (const auto &range : done_)
+    {
+        if (range.first > pos)
+            pending_.emplace_back(pos, range.first);
+        digest_->on_written(range.first, range.second - range.first);
+        pos = range.second;
+    }
+    if (pos < file_size_)
+        pending_.emplace_back(pos, file_size_);
+    if (pos > 0)
+    {
+        LOGI("Downloader", "断点续传，剩余区间数:%d", (int)pending_.size());
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const int initial = std::min(kMinWorkers, worker_limit());
+        for (int i = 0; i < initial && !pending_.empty(); ++i)
+        {
+            start_worker();
+        }
+    }
+
+    // 每秒采样一次总吞吐，仍有明显提升且未超过线程上限时再增加一个线程
+    double best_rate = 0;
+    bool ramping = true;
+    uint64_t last_received = 0;
+    auto last_time = std::chrono::steady_clock::now();
+    auto last_checkpoint = last_time;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (running_ > 0)
+        {
+            cv_.wait_for(lock, std::chrono::seconds(1));
+            if (running_ == 0)
+                continue;
+            if (cancelled_ && *cancelled_ && !failed_)
+            {
+                // 唤醒等待区间的线程退出
+                failed_ = true;
+                cv_.notify_all();
+            }
+
+            auto now = std::chrono::steady_clock::now();
+            if (std::chrono::duration<double>(now - last_checkpoint).count() >= kCheckpointSeconds)
+            {
+                last_checkpoint = now;
+                save_checkpoint(lock);
+            }
+
+            double seconds = std::chrono::duration<double>(now - last_time).count();
+            if (seconds < 1.0)
+                continue;
+
+            uint64_t received = received_.load();
+            double rate = (received - last_received) / seconds;
+            last_received = received;
+            last_time = now;
+
+            const int limit = worker_limit();
+            if (!ramping && trimmed_ && running_ < limit && has_work())
+            {
+                // 其他传输结束，上限恢复后重新试探
+                ramping = true;
+                trimmed_ = false;
+                best_rate = 0;
+            }
+            if (!ramping)
+                continue;
+
+            if (rate > best_rate * 1.1 && running_ < limit && !failed_ && has_work())
+            {
+                best_rate = rate;
+                start_worker();
+            }
+            else
+            {
+                ramping = false;
+            }
+        }
+    }
+
+    for (auto &t : threads_)
+    {
+        if (t.joinable())
+            t.join();
+    }
+
+    LOGI("Downloader", "分段下载结束 线程数:%d 失败次数:%d", (int)threads_.size(), failures_);
+
+    if (failed_ || !pending_.empty())
+    {
+        // 保存最终进度，下次从这里继续
+        if (!changed_)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            save_checkpoint(lock);
+        }
+        return false;
+    }
+    md5 = digest_->finish(file_size_);
+    return !md5.empty();
+}
+
+void RangeDownloader::save_checkpoint(std::unique_lock<std::mutex> &lock)
+{
+    if (!checkpoint_ || !done_dirty_)
+        return;
+
+    Ranges done(done_.begin(), done_.end());
+    std::string etag = etag_;
+    std::string last_modified = last_modified_;
+    done_dirty_ = false;
+
+    // 记录的区间必须已经落盘，否则断电后日志会指向未写入的数据
+    lock.unlock();
+    if (::fdatasync(fd_) == 0)
+    {
+        checkpoint_(done, etag, last_modified);
+    }
+    lock.lock();
+}
+
+void RangeDownloader::add_done(uint64_t start, uint64_t end)
+{
+    auto it = done_.upper_bound(start);
+    if (it != done_.begin())
+    {
+        auto prev = std::prev(it);
+        if (prev->second >= start)
+        {
+            start = prev->first;
+            end = std::max(end, prev->second);
+            done_.erase(prev);
+        }
+    }
+    while (it != done_.end() && it->first <= end)
+    {
+        end = std::max(end, it->second);
+        it = done_.erase(it);
+    }
+    done_[start] = end;
+    done_dirty_ = true;
+}
+
+bool RangeDownloader::check_validator(const httplib::Response &response)
+{
+    std::string etag = response.get_header_value("ETag");
+    std::string last_modified = response.get_header_value("Last-Modified");
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    bool match = true;
+    if (!etag_.empty() && !etag.empty())
+    {
+        match = etag_ == etag;
+    }
+    else if (!last_modified_.empty() && !last_modified.empty())
+    {
+        match = last_modified_ == last_modified;
+    }
+
+    if (!match)
+    {
+        LOGW("Downloader", "服务器文件已变更，放弃已下载的进度");
+        changed_ = true;
+        failed_ = true;
+        cv_.notify_all();
+        return false;
+    }
+    if (etag_.empty() && last_modified_.empty())
+    {
+        etag_ = etag;
+        last_modified_ = last_modified;
+    }
+    return true;
+}
+
+void RangeDownloader::start_worker()
+{
+    running_++;
+    threads_.emplace_back(&RangeDownloader::worker, this);
+}
+
+bool RangeDownloader::has_work()
+{
+    if (!pending_.empty())
+        return true;
+    for (const Slot &s : slots_)
+    {
+        if (s.active && s.limit - s.cursor >= 2 * kMinChunk)
+            return true;
+    }
+    return false;
+}
+
+bool RangeDownloader::take_range(Slot &slot, uint64_t chunk_size)
+{
+    if (!pending_.empty())
+    {
+        auto &front = pending_.front();
+        slot.cursor = front.first;
+        slot.limit = std::min(front.second, front.first + chunk_size);
+        if (slot.limit == front.second)
+            pending_.pop_front();
+        else
+            front.first = slot.limit;
+        slot.active = true;
+        return true;
+    }
+
+    // 队列已空，拆分剩余最多的在途区间
+    Slot *victim = nullptr;
+    for (Slot &s : slots_)
+    {
+        if (s.active && (!victim || s.limit - s.cursor > victim->limit - victim->cursor))
+            victim = &s;
+    }
+    if (!victim || victim->limit - victim->cursor < 2 * kMinChunk)
+        return false;
+
+    uint64_t mid = victim->cursor + (victim->limit - victim->cursor) / 2;
+    slot.cursor = mid;
+    slot.limit = victim->limit;
+    slot.active = true;
+    victim->limit = mid;
+    return true;
+}
+
+void RangeDownloader::worker()
+{
+    Slot *slot;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        slots_.emplace_back();
+        slot = &slots_.back();
+    }
+
+    uint64_t chunk_size = kInitialChunk;
+
+    while (true)
+    {
+        uint64_t begin;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            // 没有可领取的区间但仍有线程在下载时等待，它们失败后会把剩余区间放回队列
+            cv_.wait(lock, [&]
+                     { return failed_ || take_range(*slot, chunk_size) ||
+                              std::none_of(slots_.begin(), slots_.end(), [](const Slot &s)
+                                           { return s.active; }); });
+            if (!slot->active)
+                break;
+            begin = slot->cursor;
+        }
+
+        // 每个分块借用一次连接，等待期间不占用，连接在分块之间保持复用
+        HttpPool::Lease client = factory_();
+        auto start_time = std::chrono::steady_clock::now();
+        bool ok = client && fetch(*client, *slot);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (slot->cursor < slot->limit)
+            {
+                pending_.emplace_front(slot->cursor, slot->limit);
+                ok = false;
+            }
+            slot->active = false;
+            if (cancelled_ && *cancelled_)
+            {
+                failed_ = true;
+            }
+            else if (!ok && ++failures_ > kMaxFailures)
+            {
+                failed_ = true;
+            }
+            if (ok && seconds > 0)
+            {
+                double rate = (slot->cursor - begin) / seconds;
+                chunk_size = std::clamp<uint64_t>(static_cast<uint64_t>(rate * kChunkSeconds), kMinChunk, kMaxChunk);
+            }
+            // 并发传输增多后上限降低，多出的线程让出带宽
+            if (ok && running_ > worker_limit())
+            {
+                trimmed_ = true;
+                break;
+            }
+        }
+        cv_.notify_all();
+
+        if (!ok)
+        {
+            LOGW("Downloader", "分段下载失败，剩余区间重新排队");
+            client.discard();
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_--;
+    }
+    cv_.notify_all();
+}
+
+bool RangeDownloader::fetch(httplib::Client &client, Slot &slot)
+{
+    uint64_t start;
+    uint64_t end;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        start = slot.cursor;
+        end = slot.limit;
+    }
+
+    FileWriter out(fd_, start, [this](uint64_t offset, const char *data, size_t len)
+                   {
+                       digest_->on_data(offset, data, len);
+                       std::lock_guard<std::mutex> lock(mutex_);
+                       add_done(offset, offset + len); });
+
+    bool write_ok = true;
+    std::string range = "bytes=" + std::to_string(start) + "-" + std::to_string(end - 1);
+    auto res = client.Get(path_.c_str(), {{"Range", range}, {"Accept-Encoding", "identity"}},
+                          [this](const httplib::Response &response)
+                          { return response.status == 206 && check_validator(response); },
+                          [&](const char *data, size_t len)
+                          {
+                              if (throttle_ && !throttle_(len))
+                                  return false;
+                              // 先占用区间再写入，拆分方只会取走 cursor 之后的部分
+                              if (cancelled_ && *cancelled_)
+                                  return false;
+
+                              size_t n;
+                              bool more;
+                              {
+                                  std::lock_guard<std::mutex> lock(mutex_);
+                                  if (slot.cursor >= slot.limit)
+                                      return false;
+                                  n = static_cast<size_t>(std::min<uint64_t>(len, slot.limit - slot.cursor));
+                                  slot.cursor += n;
+                                  more = slot.cursor < slot.limit;
+                              }
+                              received_ += n;
+                              if (!out.write(data, n))
+                              {
+                                  write_ok = false;
+                                  return false;
+                              }
+                              return more;
+                          });
+
+    if (!out.close() || !write_ok)
+    {
+        // 磁盘写入失败，重试无意义
+        std::lock_guard<std::mutex> lock(mutex_);
+        failed_ = true;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    // 区间被拆分后主动中止请求，此时 res 为取消状态但数据已完整
+    return slot.cursor >= slot.limit && (res || res.error() == httplib::Error::Canceled);
+}
@@ -0,0 +1,215 @@
+#include "rate_limiter.h"
+#include <thread>
+#include <algorithm>
+#include <sstream>
+#include <cstdio>
+#include <ctime>
+#include <logger.h>
+
+namespace
+{
+    // 全局速率（时段、退避）的重新计算间隔
+    constexpr std::chrono::seconds kRateRefresh(1);
+    // 等待令牌时检查取消的间隔
+    constexpr std::chrono::milliseconds kWaitSlice(100);
+    // 退避的最低比例和最低速率
+    constexpr double kMinFactor = 0.125;
+    constexpr double kFactorStep = 0.125;
+    constexpr uint64_t kMinRate = 16 * 1024;
+    // 平滑时延超过基准的 2 倍且多出 100ms 视为拥塞，回到 1.5 倍以内逐步恢复
+    constexpr double kCongestedRatio = 2.0;
+    constexpr double kRecoveredRatio = 1.5;
+    constexpr double kRttMarginMs = 100;
+    // 基准时延每个样本最多上浮 2%，适应网络路径的变化
+    constexpr double kBaseRttDrift = 1.02;
+}
+
+TokenBucket::TokenBucket(uint64_t rate)
+    : rate_(rate), tokens_(static_cast<double>(rate)), last_(std::chrono::steady_clock::now())
+{
+}
+
+void TokenBucket::set_rate(uint64_t rate)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (rate == rate_)
+        return;
+    rate_ = rate;
+    tokens_ = std::min(tokens_, static_cast<double>(rate));
+    last_ = std::chrono::steady_clock::now();
+}
+
+std::chrono::microseconds TokenBucket::take(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (rate_ == 0)
+        return std::chrono::microseconds(0);
+
+    // 桶容量为一秒的流量
+    auto now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - last_).count();
+    last_ = now;
+    tokens_ = std::min(static_cast<double>(rate_), tokens_ + elapsed * rate_);
+    tokens_ -= bytes;
+    if (tokens_ >= 0)
+        return std::chrono::microseconds(0);
+    return std::chrono::microseconds(static_cast<int64_t>(-tokens_ * 1000000 / rate_));
+}
+
+RateLimiter::Transfer::Transfer(RateLimiter &limiter) : limiter_(limiter), bucket_(limiter.transfer_rate_)
+{
+    limiter_.active_++;
+}
+
+RateLimiter::Transfer::~Transfer()
+{
+    limiter_.active_--;
+}
+
+bool RateLimiter::Transfer::acquire(size_t bytes, const std::atomic<bool> *cancelled)
+{
+    bucket_.set_rate(limiter_.transfer_rate_);
+    auto wait = std::max(limiter_.take_global(bytes), bucket_.take(bytes));
+    auto deadline = std::chrono::steady_clock::now() + wait;
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        if (cancelled && *cancelled)
+            return false;
+        std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(
+            kWaitSlice, deadline - std::chrono::steady_clock::now()));
+    }
+    return !(cancelled && *cancelled);
+}
+
+RateLimiter::RateLimiter()
+    : transfer_rate_(0), active_(0), factor_(1.0), srtt_(0), base_rtt_(0), backoff_base_(0),
+      window_bytes_(0), window_start_(std::chrono::steady_clock::now()), observed_rate_(0), rate_(0)
+{
+}
+
+void RateLimiter::configure(const Config &config)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    config_ = config;
+    transfer_rate_ = config.transfer_rate;
+    LOGI("RateLimiter", "下载限速 全局:%lluKB/s 单个传输:%lluKB/s 时段数:%d",
+         (unsigned long long)(config.global_rate / 1024), (unsigned long long)(config.transfer_rate / 1024),
+         (int)config.schedule.size());
+    update_rate_locked();
+}
+
+std::chrono::microseconds RateLimiter::take_global(size_t bytes)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        window_bytes_ += bytes;
+        if (std::chrono::steady_clock::now() - rate_updated_ >= kRateRefresh)
+        {
+            update_rate_locked();
+        }
+    }
+    return global_.take(bytes);
+}
+
+void RateLimiter::update_rate_locked()
+{
+    auto now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - window_start_).count();
+    if (elapsed >= 1.0)
+    {
+        observed_rate_ = static_cast<uint64_t>(window_bytes_ / elapsed);
+        window_bytes_ = 0;
+        window_start_ = now;
+    }
+    rate_updated_ = now;
+
+    uint64_t rate = config_.global_rate;
+    if (!config_.schedule.empty())
+    {
+        std::time_t t = std::time(nullptr);
+        std::tm local;
+        localtime_r(&t, &local);
+        const int minute = local.tm_hour * 60 + local.tm_min;
+        for (const auto &window : config_.schedule)
+        {
+            bool in_window = window.start_minute <= window.end_minute
+                                 ? (minute >= window.start_minute && minute < window.end_minute)
+                                 : (minute >= window.start_minute || minute < window.end_minute);
+            if (in_window)
+            {
+                rate = window.rate;
+                break;
+            }
+        }
+    }
+
+    if (factor_ < 1.0)
+    {
+        const uint64_t base = rate ? rate : backoff_base_;
+        if (base > 0)
+        {
+            rate = std::max(kMinRate, static_cast<uint64_t>(base * factor_));
+        }
+    }
+
+    if (rate != rate_)
+    {
+        LOGI("RateLimiter", "下载总速率调整为 %lluKB/s", (unsigned long long)(rate / 1024));
+        rate_ = rate;
+        global_.set_rate(rate);
+    }
+}
+
+void RateLimiter::report_rtt(int rtt_ms)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    srtt_ = srtt_ > 0 ? srtt_ * 0.7 + rtt_ms * 0.3 : rtt_ms;
+    base_rtt_ = base_rtt_ > 0 ? std::min<double>(rtt_ms, base_rtt_ * kBaseRttDrift) : rtt_ms;
+
+    // 没有下载时的时延升高与下载无关
+    const bool congested = active_ > 0 && srtt_ > base_rtt_ * kCongestedRatio && srtt_ > base_rtt_ + kRttMarginMs;
+    if (congested && factor_ > kMinFactor)
+    {
+        if (factor_ >= 1.0)
+        {
+            backoff_base_ = observed_rate_;
+        }
+        factor_ = std::max(kMinFactor, factor_ / 2);
+        LOGW("RateLimiter", "MQTT 时延 %.0fms（基准 %.0fms），下载速率降为 %.0f%%", srtt_, base_rtt_, factor_ * 100);
+    }
+    else if (!congested && factor_ < 1.0 && srtt_ < base_rtt_ * kRecoveredRatio)
+    {
+        factor_ = std::min(1.0, factor_ + kFactorStep);
+        if (factor_ >= 1.0)
+        {
+            LOGI("RateLimiter", "MQTT 时延恢复，取消下载退避");
+        }
+    }
+    update_rate_locked();
+}
+
+bool RateLimiter::parse_schedule(const std::string &text, std::vector<Window> &schedule)
+{
+    schedule.clear();
+    std::istringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ';'))
+    {
+        if (item.empty())
+            continue;
+        int start_h, start_m, end_h, end_m;
+        unsigned long long kbps;
+        if (std::sscanf(item.c_str(), "%d:%d-%d:%d=%llu", &start_h, &start_m, &end_h, &end_m, &kbps) != 5 ||
+            start_h < 0 || start_h > 24 || start_m < 0 || start_m > 59 ||
+            end_h < 0 || end_h > 24 || end_m < 0 || end_m > 59)
+        {
+            return false;
+        }
+        Window window;
+        window.start_minute = start_h * 60 + start_m;
+        window.end_minute = end_h * 60 + end_m;
+        window.rate = kbps * 1024;
+        schedule.push_back(window);
+    }
+    return true;
+}
@@ -0,0 +1,152 @@
+#include "resource_probe.h"
+#include <logger.h>
+
+namespace
+{
+    // 探测结果有效期
+    constexpr std::chrono::minutes kCacheTtl(10);
+    constexpr size_t kMaxCacheEntries = 256;
+
+    void read_validators(const httplib::Headers &headers, ResourceProbe::ResourceInfo &info)
+    {
+        auto etag = headers.find("ETag");
+        if (etag != headers.end())
+            info.etag = etag->second;
+        auto last_modified = headers.find("Last-Modified");
+        if (last_modified != headers.end())
+            info.last_modified = last_modified->second;
+    }
+}
+
+bool ResourceProbe::probe(const std::string &url, const std::string &origin,
+                          httplib::Client &client, const std::string &path, ResourceInfo &info)
+{
+    bool try_head = true;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = resources_.find(url);
+        if (it != resources_.end() && std::chrono::steady_clock::now() - it->second.time < kCacheTtl)
+        {
+            info = it->second.info;
+            return true;
+        }
+        auto host = head_supported_.find(origin);
+        if (host != head_supported_.end())
+            try_head = host->second;
+    }
+
+    bool ok = false;
+    if (try_head)
+    {
+        bool head_supported = true;
+        ok = probe_head(client, path, info, head_supported);
+        if (!head_supported)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            head_supported_[origin] = false;
+        }
+    }
+    // HEAD 不可用或未声明支持分段时，用一个字节的分段请求确认
+    if (!ok || !info.accept_ranges)
+    {
+        ResourceInfo range_info;
+        if (probe_range(client, path, range_info))
+        {
+            info = range_info;
+            ok = true;
+        }
+        else if (range_info.status != 0)
+        {
+            info.status = range_info.status;
+        }
+    }
+    if (!ok)
+    {
+        return false;
+    }
+
+    LOGI("Downloader", "探测文件大小:%llu 支持分段:%d", (unsigned long long)info.size, info.accept_ranges);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (resources_.size() >= kMaxCacheEntries)
+    {
+        resources_.clear();
+    }
+    resources_[url] = {info, std::chrono::steady_clock::now()};
+    return true;
+}
+
+void ResourceProbe::invalidate(const std::string &url)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    resources_.erase(url);
+}
+
+bool ResourceProbe::probe_head(httplib::Client &client, const std::string &path, ResourceInfo &info, bool &head_supported)
+{
+    // 大小按未压缩的文件计算
+    auto res = client.Head(path.c_str(), {{"Accept-Encoding", "identity"}});
+    if (!res)
+    {
+        return false;
+    }
+    if (res->status == 405 || res->status == 501 || (res->status == 200 && !res->has_header("Content-Length")))
+    {
+        head_supported = false;
+        return false;
+    }
+    if (res->status != 200)
+    {
+        info.status = res->status;
+        return false;
+    }
+
+    info.size = std::stoull(res->get_header_value("Content-Length"));
+    info.accept_ranges = res->get_header_value("Accept-Ranges") == "bytes";
+    read_validators(res->headers, info);
+    return true;
+}
+
+bool ResourceProbe::probe_range(httplib::Client &client, const std::string &path, ResourceInfo &info)
+{
+    int status = 0;
+    httplib::Headers headers;
+    // 只需要响应头，服务器忽略 Range 返回 200 时立即中止，不下载内容
+    client.Get(path.c_str(), {{"Range", "bytes=0-0"}, {"Accept-Encoding", "identity"}},
+               [&](const httplib::Response &response)
+               {
+                   status = response.status;
+                   headers = response.headers;
+                   return response.status == 206;
+               },
+               [](const char *, size_t)
+               { return true; });
+
+    if (status == 206)
+    {
+        // Content-Range: bytes 0-0/总大小
+        auto it = headers.find("Content-Range");
+        if (it == headers.end())
+            return false;
+        size_t slash = it->second.rfind('/');
+        if (slash == std::string::npos || it->second.compare(slash + 1, std::string::npos, "*") == 0)
+            return false;
+        info.size = std::stoull(it->second.substr(slash + 1));
+        info.accept_ranges = true;
+    }
+    else if (status == 200)
+    {
+        auto it = headers.find("Content-Length");
+        if (it == headers.end())
+            return false;
+        info.size = std::stoull(it->second);
+        info.accept_ranges = false;
+    }
+    else
+    {
+        info.status = status;
+        return false;
+    }
+    read_validators(headers, info);
+    return true;
+}
@@ -0,0 +1,106 @@
+#include "retry_policy.h"
+#include <algorithm>
+#include <logger.h>
+
+namespace
+{
+    // 连续失败多少次后断开
+    constexpr int kFailureThreshold = 5;
+    constexpr std::chrono::milliseconds kMinCooldown = std::chrono::seconds(30);
+    constexpr std::chrono::milliseconds kMaxCooldown = std::chrono::minutes(10);
+    // 探测请求长时间没有结果（如被取消）时允许新的探测
+    constexpr std::chrono::milliseconds kProbeTimeout = std::chrono::seconds(60);
+    // 等待探测结果的其他请求的重新检查间隔
+    constexpr std::chrono::milliseconds kProbeWait = std::chrono::seconds(5);
+
+    std::mt19937 make_rng()
+    {
+        std::random_device device;
+        return std::mt19937(device() ^ static_cast<unsigned>(std::chrono::steady_clock::now().time_since_epoch().count()));
+    }
+}
+
+RetryPolicy::RetryPolicy(int max_attempts, std::chrono::milliseconds base, std::chrono::milliseconds cap)
+    : max_attempts_(max_attempts), base_(base), cap_(cap), rng_(make_rng())
+{
+}
+
+std::chrono::milliseconds RetryPolicy::delay(int attempts)
+{
+    int64_t ceiling = base_.count();
+    for (int i = 1; i < attempts && ceiling < cap_.count(); ++i)
+    {
+        ceiling *= 2;
+    }
+    ceiling = std::min<int64_t>(ceiling, cap_.count());
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::uniform_int_distribution<int64_t> dist(ceiling / 2, ceiling);
+    return std::chrono::milliseconds(dist(rng_));
+}
+
+CircuitBreaker::CircuitBreaker() : rng_(make_rng())
+{
+}
+
+std::chrono::milliseconds CircuitBreaker::jittered(std::chrono::milliseconds value)
+{
+    std::uniform_int_distribution<int64_t> dist(value.count() * 3 / 4, value.count() * 5 / 4);
+    return std::chrono::milliseconds(dist(rng_));
+}
+
+std::chrono::milliseconds CircuitBreaker::check(const std::string &origin)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(origin);
+    if (it == entries_.end() || it->second.state == State::Closed)
+        return std::chrono::milliseconds(0);
+
+    Entry &entry = it->second;
+    auto now = std::chrono::steady_clock::now();
+    if (entry.state == State::Open && now < entry.until)
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(entry.until - now) + std::chrono::milliseconds(1);
+    }
+    if (entry.state == State::HalfOpen && now < entry.until)
+    {
+        // 探测请求尚未结束
+        return kProbeWait;
+    }
+
+    entry.state = State::HalfOpen;
+    entry.until = now + kProbeTimeout;
+    LOGI("CircuitBreaker", "尝试恢复请求 %s", origin.c_str());
+    return std::chrono::milliseconds(0);
+}
+
+void CircuitBreaker::record_success(const std::string &origin)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(origin);
+    if (it == entries_.end())
+        return;
+    if (it->second.state != State::Closed)
+    {
+        LOGI("CircuitBreaker", "服务器恢复 %s", origin.c_str());
+    }
+    entries_.erase(it);
+}
+
+void CircuitBreaker::record_failure(const std::string &origin)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry &entry = entries_[origin];
+    entry.failures++;
+    if (entry.state == State::Closed && entry.failures < kFailureThreshold)
+        return;
+    if (entry.state == State::Open)
+        return;
+
+    // 首次断开或探测失败，断开时间加倍
+    entry.cooldown = entry.state == State::HalfOpen ? std::min(entry.cooldown * 2, kMaxCooldown) : kMinCooldown;
+    entry.state = State::Open;
+    const std::chrono::milliseconds wait = jittered(entry.cooldown);
+    entry.until = std::chrono::steady_clock::now() + wait;
+    LOGW("CircuitBreaker", "连续失败 %d 次，暂停请求 %s %lld 秒", entry.failures, origin.c_str(), (long long)(wait.count() / 1000));
+}
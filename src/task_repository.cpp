@@ -10,6 +10,7 @@
 #include <memory>
 #include <vector>
 #include "Tools.h"
+#include "atomic_file.h"
 
 TaskRepository::TaskRepository()
 {
@@ -103,6 +104,71 @@ std::vector<std::unique_ptr<MediaItem>> TaskRepository::getPlayList(const std::s
     return playList;
 }
 
+std::string TaskRepository::saveFields(std::string data, std::map<std::string, std::string> &fields)
+{
+    try
+    {
+        Json::Value root;
+        Json::Reader reader;
+        if (!reader.parse(data, root))
+        {
+            std::cerr << "数据解析失败： " << data << std::endl;
+            return "";
+        }
+        std::string device = root["device"].asString();
+        if (device.empty())
+            return "";
+
+        const Json::Value &values = root["fields"];
+        for (const auto &name : values.getMemberNames())
+        {
+            fields[name] = values[name].asString();
+        }
+
+        // 与已保存的字段合并后写回磁盘
+        std::map<std::string, std::string> merged = getFields(device);
+        for (const auto &field : fields)
+        {
+            merged[field.first] = field.second;
+        }
+        Json::Value saved(Json::objectValue);
+        for (const auto &field : merged)
+        {
+            saved[field.first] = field.second;
+        }
+        Json::StreamWriterBuilder wbuilder;
+        saveFile(device + ".fields", Json::writeString(wbuilder, saved));
+        return device;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "save fields fail:" << e.what() << '\n';
+    }
+    return "";
+}
+
+std::map<std::string, std::string> TaskRepository::getFields(const std::string &device_id)
+{
+    std::map<std::string, std::string> fields;
+    std::string jsonString = readFile(device_id + ".fields");
+    if (jsonString.empty())
+    {
+        return fields;
+    }
+
+    Json::Value root;
+    Json::Reader reader;
+    if (!reader.parse(jsonString, root) || !root.isObject())
+    {
+        return fields;
+    }
+    for (const auto &name : root.getMemberNames())
+    {
+        fields[name] = root[name].asString();
+    }
+    return fields;
+}
+
 std::string TaskRepository::getTaskId(std::string device_id)
 {
     return readFile(device_id + ".task");
@@ -152,36 +218,9 @@ void TaskRepository::saveFile(std::string file_name, std::string content)
     // 拼接完整路径
     std::string full_path = work_dir_ + file_name;
 
-    // 打开文件（二进制写入模式）
-    FILE *fp = fopen(full_path.c_str(), "wb");
-    if (!fp)
-    {
-        throw std::runtime_error("无法打开文件 " + full_path + ": " + strerror(errno));
-    }
-
-    try
-    {
-        // 写入内容
-        size_t bytes_written = fwrite(content.data(), sizeof(char), content.size(), fp);
-        // 验证写入完整性
-        if (bytes_written != content.size())
-        {
-            throw std::runtime_error("文件写入不完整，预期写入 " +
-                                     std::to_string(content.size()) +
-                                     " 字节，实际写入 " +
-                                     std::to_string(bytes_written) + " 字节");
-        }
-        // 刷新缓冲区确保数据写入磁盘
-        if (fflush(fp) != 0)
-        {
-            throw std::runtime_error("刷新缓冲区失败: " + std::string(strerror(errno)));
-        }
-        fclose(fp);
-    }
-    catch (...)
+    // 写入临时文件并落盘后替换，断电时不会留下写了一半的文件
+    if (!AtomicFile::write(full_path, content))
     {
-        // 发生异常时确保文件句柄关闭
-        fclose(fp);
-        throw; // 重新抛出异常
+        throw std::runtime_error("写入文件失败 " + full_path + ": " + strerror(errno));
     }
 }
\ No newline at end of file